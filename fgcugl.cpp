@@ -9,23 +9,590 @@
 
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <cstdarg>
+#include <cstring>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "fgcugl.h"
 
 namespace fgcugl
 {
-	static GLFWwindow* s_window;
+	//-----------------------------------------------------------------------------
+	// frame batch
+	//
+	// Draw functions do not call OpenGL directly, they append vertices and
+	// indices to the frame batch and record a command with a 64-bit sort key.
+	// windowPaint radix sorts the commands by key and merges neighbours that
+	// share render state into a single glDrawElements call.
+	//
+	// sort key layout (most significant first):
+	//		63		blended pass, with a depth buffer draws that blend follow
+	//				the opaque ones, see addCommand
+	//		62..39	draw order from layer and depth, see updateDepth
+	//		38..32	primitive type (filled, lines, points, text)
+	//		31..0	render state index
+	//-----------------------------------------------------------------------------
+
+	// color packed as bytes in memory order for glColorPointer
+	struct PackedColor
+	{
+		GLubyte red, green, blue, alpha;
+	};
+
+	// vertex layout shared by every primitive in the frame, shapes use
+	// texture coordinate 0,0 which is a white texel in every texture
+	struct Vertex
+	{
+		GLfloat x, y, z;
+		GLfloat u, v;
+		PackedColor color;
+	};
+
+	// primitive types in the order they are drawn within a layer
+	enum PrimitiveType
+	{
+		PrimitiveFilled = 0,
+		PrimitiveLines = 1,
+		PrimitivePoints = 2,
+		PrimitiveText = 3		// triangles, kept above the shapes of their layer
+	};
+
+	// OpenGL texture of a Texture::id, looked up on the main thread before
+	// the frame is drawn so drawing never reads the texture table
+	struct TextureBinding
+	{
+		GLuint name;		// 0 for the white texture
+		int width;			// of the OpenGL texture in pixels
+		int height;
+	};
+
+	// render state that requires a new draw call when it changes
+	struct BatchState
+	{
+		PrimitiveType type;
+		GLfloat size;		// point size or line width
+		bool smooth;
+		unsigned int texture;	// Texture::id, 0 for shapes
+		int blend;				// BlendMode, set by addCommand from the batch
+		bool distanceField;		// texture is a distance field cut at alpha 0.5, see buildSdfFont
+		TextureBinding binding;	// set by resolveTextures, not part of the state
+	};
+
+	// one draw function call waiting to be submitted
+	struct DrawCommand
+	{
+		uint64_t key;
+		GLuint firstIndex;
+		GLuint indexCount;
+	};
+
+	// sort record, index refers to the frame command list
+	struct SortItem
+	{
+		uint64_t key;
+		GLuint command;
+	};
+
+	// sorted commands drawn by one glDrawElements call
+	struct DrawRun
+	{
+		BatchState state;
+		size_t firstIndex;
+		size_t indexCount;
+	};
+
+	// sprite recorded by a command list, its texture coordinates are
+	// filled in when the list is merged into a frame
+	struct SpriteFixup
+	{
+		GLuint firstVertex;		// bottom left, then the other corners anticlockwise
+		Texture texture;
+		Rect source;
+		bool hasSource;			// otherwise the whole texture
+		int flip;
+	};
+
+	struct FrameBatch
+	{
+		std::vector<Vertex> vertices;
+		std::vector<GLuint> indices;
+		std::vector<DrawCommand> commands;
+		std::vector<BatchState> states;
+		size_t lastState = 0;
+
+		// command lists record off the main thread, where the texture
+		// table cannot be read, see batchSprite
+		bool deferTextures = false;
+		std::vector<SpriteFixup> fixups;
+
+		// scratch memory of submitBatch, freed at once by resetBatch
+		FrameArena scratch;
+		SortItem* sorted = nullptr;
+		GLuint* submitIndices = nullptr;
+		GLuint* gatherOffsets = nullptr;	// of each sorted command in submitIndices
+		size_t* histograms = nullptr;		// 8 x 256 counts per sort chunk
+
+		int layer = 0;
+		float depth = 0;
+		int blend = BlendOpaque;
+		bool depthBuffer = false;
+		bool multisample = false;	// edges are anti-aliased, smooth states are dropped
+
+		// derived from layer and depth by updateDepth
+		uint64_t order = 0;
+		GLfloat vertexZ = 0;
+
+		FrameStats stats = {};
+		unsigned int sharedStates = 0;	// see FrameStats, counted until submitted
+	};
+
+	// OpenGL state set by the last run submitted, so unchanged state is not set again
+	struct StateCache
+	{
+		bool valid = false;		// nothing applied yet this frame
+		BatchState state = {};
+	};
+
+	// frame handoff between paint and a context's render thread
+	struct RenderThread
+	{
+		std::thread thread;
+		std::mutex mutex;					// guards everything below
+		std::condition_variable wake;		// a frame was handed over, or stop
+		std::condition_variable idle;		// the frame was drawn
+		bool frameReady = false;			// batch holds a frame not drawn yet
+		bool stopping = false;
+		FrameBatch batch;					// frame being drawn
+		int viewportWidth = 0;				// resize to apply before drawing it
+		int viewportHeight = 0;
+		bool viewportChanged = false;
+		GLFWwindow* uploadWindow = nullptr;	// hidden, current on the main thread for texture calls
+	};
+
+	// everything a Context owns, see fgcugl.h
+	struct ContextData
+	{
+		GLFWwindow* window = nullptr;	// null when the context is closed
+		GLuint whiteTexture = 0;		// bound for runs that have no sprites
+		int viewportWidth = 0;			// framebuffer size from the resize callback
+		int viewportHeight = 0;
+		bool viewportChanged = false;	// applied by the next paint
+		StateCache cache;
+
+		// headless windows draw into framebuffer, multisampled with
+		// WindowOptions::samples, and paint resolves it into frameTexture
+		GLuint framebuffer = 0;			// 0 when drawing to the window
+		GLuint renderbuffers[2] = {};	// color and depth of framebuffer
+		GLuint resolveFramebuffer = 0;
+		GLuint frameTexture = 0;		// shared like other textures, see readFrame
+		int frameWidth = 0;
+		int frameHeight = 0;
+
+		FrameBatch batch;
+		FrameArena arena;				// see getFrameArena
+		std::unique_ptr<RenderThread> render;	// null when paint draws itself
+
+		// command lists recording for this context, merged by paint
+		std::mutex listMutex;
+		std::vector<CommandListData*> lists;
+	};
+
+	// glyph geometry kept by a TextBlock, see fgcugl.h
+	struct TextBlockData
+	{
+		std::string text;
+		int size = 1;
+		unsigned int color = White;
+		std::vector<Vertex> vertices;	// four per run of pixels, relative to the position drawn at
+	};
+
+	// line of a TextLayout, a span of its text
+	struct TextLine
+	{
+		uint32_t start;
+		uint32_t length;
+	};
+
+	// text split into lines by measureText and drawTextBox
+	struct TextLayout
+	{
+		uint64_t hash = 0;			// of the text and wrapColumns
+		int wrapColumns = 0;		// characters per line, 0 for no wrapping
+		std::string text;			// compared when the hash matches
+		std::vector<TextLine> lines;
+		uint32_t widest = 0;		// characters in the longest line
+		int prev = -1;				// more recently used layout
+		int next = -1;				// less recently used layout
+	};
+
+	// recently used layouts, found through an open addressed table of
+	// indices and evicted least recently used first.  Evicted layouts keep
+	// their buffers, so text no longer than the last is laid out in place.
+	struct LayoutCache
+	{
+		std::mutex mutex;				// guards everything below
+		std::vector<TextLayout> layouts;
+		std::vector<int> table;			// index into layouts, -1 for empty
+		int head = -1;					// most recently used
+		int tail = -1;					// least recently used
+	};
+	static LayoutCache s_layouts;
+
+	// triangles of a polygon, see drawPolygon
+	struct Tessellation
+	{
+		uint64_t hash = 0;				// of the points
+		std::vector<Point> points;		// compared when the hash matches
+		std::vector<GLuint> triangles;	// three indices into points for each
+	};
+
+	// polygons triangulated lately.  Polygons are mostly drawn with the
+	// same points every frame, so each slot keeps the last polygon that
+	// hashed to it, and its buffers for the next one.
+	struct TessellationCache
+	{
+		std::mutex mutex;				// guards everything below
+		std::vector<Tessellation> slots;
+		std::vector<GLuint> remaining;	// corners not clipped yet, while triangulating
+	};
+	static TessellationCache s_tessellations;
+
+	// everything a CommandList owns, see fgcugl.h
+	struct CommandListData
+	{
+		ContextData* context;
+		FrameBatch recording;		// draws since the last submit
+		FrameBatch submitted;		// guarded by the context's listMutex
+		std::vector<GLuint> stateMap;	// submitted state index to frame state index
+	};
+
+	// open contexts, closed by cleanup
+	static std::vector<ContextData*> s_contexts;
+
+	// an OpenGL texture made by loadTexture, Texture::id is the index + 1
+	struct TextureSlot
+	{
+		GLuint name;		// 0 when the slot is free
+		int width;			// of the OpenGL texture in pixels
+		int height;
+		int originX;		// where image pixel 0,0 is in the OpenGL texture
+		int originY;
+		bool loading;		// reserved by loadTextureAsync, name is 0 until uploaded
+		bool freed;			// freeTexture was called while loading
+		bool atlasPage;		// owned by an atlas, released by freeAtlas only
+	};
+
+	static std::vector<TextureSlot> s_textures;
+
+	// free span along the packed edge of an atlas page, y grows down
+	struct SkylineNode
+	{
+		int x, y, width;
+	};
+
+	struct AtlasPage
+	{
+		unsigned int texture;				// Texture::id of the page
+		std::vector<SkylineNode> skyline;
+	};
+
+	// a texture atlas made by createAtlas, TextureAtlas::id is the index + 1
+	struct AtlasData
+	{
+		int pageSize;		// 0 when the slot is free
+		int padding;
+		bool smooth;
+		std::vector<AtlasPage> pages;
+	};
+
+	static std::vector<AtlasData> s_atlases;
+
+	static const int ATLAS_FIRST_PAGE_SIZE = 256;
+
+	//-----------------------------------------------------------------------------
+	// asset loader
+	//
+	// Async loads are read and decoded by one worker thread, then finished
+	// by windowPaint on the main thread, which owns the OpenGL context.
+	// Loads finish in the order they were started, as many per paint as
+	// the upload budget allows.
+	//-----------------------------------------------------------------------------
+
+	enum LoadType {
+		LoadImageFile,		// decode an image file into a reserved texture
+		LoadPackImage,		// upload an image from a pack into a reserved texture
+		LoadPackFile		// map a pack file into a reserved pack handle
+	};
+
+	struct LoadJob
+	{
+		LoadType type;
+		std::string filename;		// image or pack file
+		std::string name;			// asset name in the pack
+		AssetPack pack;				// pack of the image, or the reserved pack
+		unsigned int texture = 0;	// reserved Texture::id
+		bool smooth = false;
+
+		// filled in on the worker thread
+		Image image;
+		MappedFile file;
+	};
+
+	struct AssetLoader
+	{
+		std::thread worker;					// started by the first async load
+		std::mutex mutex;					// guards queued, done and stopping
+		std::condition_variable wake;
+		std::deque<std::unique_ptr<LoadJob>> queued;	// waiting for the worker
+		std::deque<std::unique_ptr<LoadJob>> done;		// waiting for windowPaint
+		bool stopping = false;
+		int pending = 0;					// started and not finished
+		size_t budgetBytes = 4 << 20;		// uploaded per paint
+		double budgetSeconds = 0.002;
+
+		~AssetLoader()
+		{
+			stop();
+		}
+
+		// end the worker thread and drop unfinished loads
+		void stop()
+		{
+			if (!worker.joinable())
+				return;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake.notify_one();
+			worker.join();
+
+			queued.clear();
+			done.clear();
+			stopping = false;
+			pending = 0;
+		}
+	};
+
+	static AssetLoader s_loader;
+
+	static const int KEY_ORDER_SHIFT = 39;
+	static const uint64_t KEY_BLENDED_PASS = 1 << 24;	// above the 24-bit order
+	static const int KEY_TYPE_SHIFT = 32;
+	static const int KEY_STATE_SHIFT = 0;
+	static const uint64_t KEY_STATE_MASK = 0xFFFFFFFF;
+	static const uint64_t MAX_BATCH_STATES = KEY_STATE_MASK + 1;
+
+	// stack buffer of drawNumber and drawFormatted, longer text is cut off
+	static const size_t FORMAT_BUFFER_SIZE = 256;
+
+	// text layouts kept by measureText and drawTextBox, the table has
+	// twice as many slots so probes stay short
+	static const size_t LAYOUT_CACHE_SIZE = 256;
+	static const size_t LAYOUT_TABLE_SIZE = 2 * LAYOUT_CACHE_SIZE;
+
+	// slots of the polygon triangle cache, a power of 2
+	static const size_t TESSELLATION_CACHE_SIZE = 256;
+
+	// distance field fonts have this many texels per font pixel, and the
+	// field reaches fully in or out this many texels from an edge, which
+	// is also the padding around each glyph so filtering stays inside it
+	static const int SDF_RESOLUTION = 4;
+	static const int SDF_SPREAD = 4;
+	static const int SDF_COLUMNS = 16;
+
+	// glyphs in CHARACTERS, the first is space, and the one drawn for
+	// bytes it has none for
+	static const int CHARACTER_COUNT = (int)(sizeof(CHARACTERS) / sizeof(CHARACTERS[0]));
+	static const int FALLBACK_CHARACTER = '?' - 32;
+
+	// horizontal runs of set pixels in each row of every glyph in
+	// CHARACTERS, so text is drawn as a quad per run rather than a point
+	// per pixel; a row of 8 pixels has at most 4 runs
+	struct GlyphRuns
+	{
+		uint8_t count[CHARACTER_COUNT][8];
+		uint8_t runs[CHARACTER_COUNT][8][4];	// first pixel << 4 | length
+	};
+
+	constexpr GlyphRuns makeGlyphRuns()
+	{
+		GlyphRuns table = {};
+
+		for (int glyph = 0; glyph < CHARACTER_COUNT; glyph++)
+		{
+			for (int row = 0; row < 8; row++)
+			{
+				uint8_t byte = CHARACTERS[glyph][row];
+				int count = 0;
+
+				for (int bit = 0; bit < 8; bit++)
+				{
+					if (!(byte & (0x80 >> bit)))
+						continue;
+
+					int start = bit;
+					while (bit + 1 < 8 && (byte & (0x80 >> (bit + 1))))
+						bit++;
+					table.runs[glyph][row][count++] = (uint8_t)(start << 4 | (bit + 1 - start));
+				}
+				table.count[glyph][row] = (uint8_t)count;
+			}
+		}
+
+		return table;
+	}
+
+	static constexpr GlyphRuns GLYPH_RUNS = makeGlyphRuns();
+
+	// frames smaller than this many commands per thread are sorted and
+	// gathered on one thread, below it starting jobs costs more than it saves
+	static const int PARALLEL_COMMANDS = 8192;
+
+	// longest miter drawn, in line widths, before JoinMiter bevels instead
+	static const float MITER_LIMIT = 4;
+	// most triangles in a round join or cap
+	static const int MAX_ARC_STEPS = 64;
 
 	// GLFW window resize callback function prototype
 	void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 
 	// color function prototype 
-	void setColor(unsigned int);
+	PackedColor packColor(unsigned int);
+
+	// buffers cleared by windowPaint
+	GLbitfield clearMask(const FrameBatch& batch);
+
+	// text formatting function prototypes
+	size_t formatNumber(char* buffer, long long value);
+	size_t formatText(char* buffer, size_t size, const char* format, va_list args);
+	char* formatDigits(char* end, unsigned long long value, unsigned int base, bool upper);
+	char* formatFixed(char* end, double value, int decimals);
+
+	// text layout function prototypes
+	int wrapColumns(float width, int size);
+	const TextLayout& findLayout(std::string_view text, int columns);
+	void splitLines(TextLayout& layout);
+	void evictLayout(LayoutCache& cache, int index);
+	void linkLayout(LayoutCache& cache, int index);
+	void unlinkLayout(LayoutCache& cache, int index);
+
+	// polygon tessellation function prototypes
+	const Tessellation& findTessellation(const Point* points, int count);
+	void triangulate(const Point* points, int count, std::vector<GLuint>& remaining, std::vector<GLuint>& triangles);
+	bool earHasCorner(const Point* points, const std::vector<GLuint>& remaining, GLuint a, GLuint b, GLuint c);
+	float turn(Point a, Point b, Point c);
+	bool samePoint(Point a, Point b);
+
+	// context function prototypes
+	void closeContext(ContextData& context);
+	bool createOffscreen(ContextData& context, int width, int height, int samples, bool depth);
+	void destroyOffscreen(ContextData& context);
+	void presentFrame(ContextData& context, const FrameBatch& batch);
+
+	// texture function prototypes
+	GLuint createTexture(int width, int height, bool smooth);
+	unsigned int addTextureSlot(const TextureSlot& slot);
+	const TextureSlot* findTexture(unsigned int id);
+	void releaseTextureSlot(unsigned int id);
+	bool textureLoading(unsigned int id);
+	TextureSlot createImageTexture(const unsigned char* pixels, int width, int height, bool smooth);
+	unsigned int reserveTextureSlot();
+	void fillTextureSlot(unsigned int id, const unsigned char* pixels, int width, int height, bool smooth);
+	void uploadPadded(const unsigned char* pixels, int x, int y, int width, int height, int padding);
+
+	// atlas function prototypes
+	AtlasPage* addAtlasPage(AtlasData& atlas);
+	void growAtlasPage(AtlasData& atlas, AtlasPage& page);
+	bool skylinePack(std::vector<SkylineNode>& skyline, int size, int width, int height, int& x, int& y);
+
+	// distance field font function prototypes
+	SdfFont buildSdfFont(const std::vector<uint8_t>& glyphs, int glyphWidth, int glyphHeight, int count, int first);
+	float glyphDistance(const uint8_t* glyph, int width, int height, float x, float y);
+
+	// asset loader function prototypes
+	void startLoad(std::unique_ptr<LoadJob> job);
+	void runLoader();
+	void readLoad(LoadJob& job);
+	size_t uploadSize(const LoadJob& job);
+	void finishLoad(LoadJob& job);
+	void finishLoads();
+
+	// frame batch function prototypes
+	void batchQuad(FrameBatch& batch, float x, float y, float width, float height, unsigned int color);
+	void batchPoint(FrameBatch& batch, float x, float y, float size, unsigned int color, bool smooth);
+	void batchLine(FrameBatch& batch, float x1, float y1, float x2, float y2, float width, unsigned int color, bool smooth);
+	void batchPolyline(FrameBatch& batch, const Point* points, int count, float width, unsigned int color, int join,
+		int cap, bool closed);
+	void batchPolygon(FrameBatch& batch, const Point* points, int count, unsigned int color);
+	void addSegment(FrameBatch& batch, Point start, Point end, Point direction, float half, PackedColor color);
+	void addJoin(FrameBatch& batch, Point point, Point before, Point after, float half, int join, PackedColor color);
+	void addArc(FrameBatch& batch, Point center, Point start, float angle, float radius, PackedColor color);
+	void batchGradientQuad(FrameBatch& batch, float x, float y, float width, float height, unsigned int bottomLeft,
+		unsigned int bottomRight, unsigned int topRight, unsigned int topLeft);
+	void batchCircle(FrameBatch& batch, float x, float y, float radius, unsigned int centerColor,
+		unsigned int edgeColor, int sides);
+	void batchText(FrameBatch& batch, float x, float y, std::string_view text, int size, unsigned int color);
+	void batchFontText(FrameBatch& batch, float x, float y, std::string_view text, const BitmapFont& font, int size,
+		unsigned int color);
+	void batchTextBlock(FrameBatch& batch, float x, float y, const TextBlockData& block);
+	void layoutTextBlock(TextBlockData& block);
+	void batchTextBox(FrameBatch& batch, const Rect& box, std::string_view text, int size, unsigned int color,
+		int align, bool wrap);
+	void batchSprite(FrameBatch& batch, const Texture& texture, const Rect* source, float x, float y,
+		float width, float height, float rotation, unsigned int tint, int flip);
+	void batchSdfText(FrameBatch& batch, float x, float y, std::string_view text, const SdfFont& font, float scale,
+		float rotation, unsigned int color);
+	void spriteCoordinates(const TextureSlot& slot, const Texture& texture, const Rect* source, int flip,
+		GLfloat& u0, GLfloat& v0, GLfloat& u1, GLfloat& v1);
+	void appendBatch(FrameBatch& target, const FrameBatch& source, std::vector<GLuint>& stateMap);
+	void mergeCommandLists(ContextData& context);
+	GLuint addVertex(FrameBatch& batch, float x, float y, PackedColor color, GLfloat u = 0, GLfloat v = 0);
+	void addQuad(FrameBatch& batch, float x, float y, float width, float height, PackedColor color);
+	void addCommand(FrameBatch& batch, BatchState state, size_t firstIndex);
+	void updateDepth(FrameBatch& batch);
+	void resolveTextures(FrameBatch& batch);
+	void submitBatch(ContextData& context, FrameBatch& batch);
+	void resetBatch(FrameBatch& batch);
+
+	// render thread function prototypes
+	void startRenderThread(ContextData& context);
+	void stopRenderThread(ContextData& context);
+	void runRenderThread(ContextData* context);
+	void handOffFrame(ContextData& context);
+	void waitForFrame(ContextData& context);
+	void waitForRenderThreads();
+	GLFWwindow* mainThreadWindow(const ContextData& context);
+
+	//-----------------------------------------------------------------------------
+	// Context
+	//-----------------------------------------------------------------------------
+
+	Context::Context() : m_data(new ContextData)
+	{
+	}
+
+	Context::~Context()
+	{
+		close();
+	}
+
+	bool Context::open(int width, int height, const std::string& title, const WindowOptions& options)
+	{
+		return open(width, height, title.c_str(), options);
+	}
 
-	void openWindow(int width, int height, std::string title, bool resizable)
+	bool Context::open(int width, int height, const char* title, const WindowOptions& options)
 	{
-		// inititalize the GLFW
+		// inititalize the GLFW, later calls do nothing
 		if (!glfwInit())
-			return;
+			return false;
 
 
 		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -35,26 +602,56 @@ namespace fgcugl
 		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 #endif
 
-		if (resizable)
+		if (options.resizable)
 			glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 		else
 			glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
+		glfwWindowHint(GLFW_DEPTH_BITS, options.depthBuffer && !options.headless ? 24 : 0);
+		glfwWindowHint(GLFW_SAMPLES, options.headless ? 0 : std::max(options.samples, 0));
+		glfwWindowHint(GLFW_VISIBLE, options.headless ? GLFW_FALSE : GLFW_TRUE);
 
-		// create a windowed mode and its OpenGL Contect
-		s_window = glfwCreateWindow(width, height, title.c_str(), NULL, NULL);
 
-		if (!s_window)
-		{
-			glfwTerminate();
-			return;
-		}
+		// create a windowed mode and its OpenGL Contect, sharing objects with
+		// the windows already open so textures are uploaded once for all of
+		// them.  A window being replaced is closed only once the new one
+		// shares its objects, or the last window would take them all along.
+		GLFWwindow* share = NULL;
+		if (m_data->window)
+			share = mainThreadWindow(*m_data);
+		else if (!s_contexts.empty())
+			share = mainThreadWindow(*s_contexts.front());
+		GLFWwindow* window = glfwCreateWindow(width, height, title, NULL, share);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+		close();
+		if (!window)
+			return false;
+
+		m_data->window = window;
+		s_contexts.push_back(m_data.get());
 
 		// set callback function to resize the window
-		glfwSetFramebufferSizeCallback(s_window, framebuffer_size_callback);
+		glfwSetWindowUserPointer(window, m_data.get());
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
 		// make the window's context current
-		glfwMakeContextCurrent(s_window);
+		glfwMakeContextCurrent(window);
+
+		// a headless window is never shown, frames go to a framebuffer
+		// object the size of the window instead
+		if (options.headless && (glewInit() != GLEW_OK
+			|| !createOffscreen(*m_data, width, height, std::max(options.samples, 0), options.depthBuffer)))
+		{
+			closeContext(*m_data);
+			return false;
+		}
+
+		// multisampling anti-aliases the edges of everything drawn, so
+		// points and lines need no smoothing state of their own
+		m_data->batch.multisample = options.samples > 0;
+		if (options.samples > 0)
+			glEnable(GL_MULTISAMPLE);
 
 		// specify the part of the window to which OpenGL will 
 		// draw (in pixels), confert from normalized to pixels
@@ -75,234 +672,3950 @@ namespace fgcugl
 		// same as above
 		glLoadIdentity();
 		
+		// less-or-equal so draws at the same depth keep painter's order
+		FrameBatch& batch = m_data->batch;
+		batch.depthBuffer = options.depthBuffer;
+		if (options.depthBuffer)
+		{
+			glEnable(GL_DEPTH_TEST);
+			glDepthFunc(GL_LEQUAL);
+			glClearDepth(1.0);
+		}
+		updateDepth(batch);
+
+		// texel used to draw shapes when no texture is bound
+		const GLubyte white[] = { 0xFF, 0xFF, 0xFF, 0xFF };
+		m_data->whiteTexture = createTexture(1, 1, false);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+
 		// set background to black and clear the screen		
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
+		glClear(clearMask(batch));
+
+		if (options.renderThread)
+			startRenderThread(*m_data);
 
+		return true;
 	}
 
-	bool windowClosing()
+	void Context::close()
 	{
-		return glfwWindowShouldClose(s_window);
+		if (m_data->window)
+			closeContext(*m_data);
 	}
 
-	void windowPaint()
+	bool Context::isOpen() const
 	{
-		// swap front and back buffers
-		glfwSwapBuffers(s_window);
-		// clear new buffer after the swap
-		glClear(GL_COLOR_BUFFER_BIT);		
+		return m_data->window != nullptr;
 	}
 
-	double getTime()
+	bool Context::closing() const
 	{
-		return glfwGetTime();
+		return !m_data->window || glfwWindowShouldClose(m_data->window);
 	}
 
-	unsigned char getKey()
+	void Context::paint()
+	{
+		// the frame's scratch memory is no longer needed
+		m_data->arena.reset();
+
+		// nothing to draw into, drop what was recorded
+		if (!m_data->window)
+		{
+			resetBatch(m_data->batch);
+			return;
+		}
+
+		// the render thread draws and swaps while the program goes on
+		if (m_data->render)
+		{
+			if (!glfwGetCurrentContext())
+				glfwMakeContextCurrent(m_data->render->uploadWindow);
+
+			finishLoads();
+			mergeCommandLists(*m_data);
+			resolveTextures(m_data->batch);
+			handOffFrame(*m_data);
+			return;
+		}
+
+		// OpenGL calls go to the current context, switching is slow so
+		// only do it when another window was painted last.  Switching
+		// flushes the previous context, so textures it changed are ready
+		// here; submitBatch binds textures again every frame.
+		if (glfwGetCurrentContext() != m_data->window)
+			glfwMakeContextCurrent(m_data->window);
+
+		// apply a resize seen by the callback
+		if (m_data->viewportChanged)
+		{
+			glViewport(0, 0, m_data->viewportWidth, m_data->viewportHeight);
+			m_data->viewportChanged = false;
+		}
+
+		// upload textures the loader thread has finished reading
+		finishLoads();
+		// add the draws other threads submitted
+		mergeCommandLists(*m_data);
+		// draw everything recorded since the last paint
+		resolveTextures(m_data->batch);
+		submitBatch(*m_data, m_data->batch);
+		// swap front and back buffers and clear the new one
+		presentFrame(*m_data, m_data->batch);
+	}
+
+	bool Context::readFrame(Image& image)
+	{
+		ContextData& context = *m_data;
+		if (!context.frameTexture)
+			return false;
+
+		// the frame texture is shared, so the main thread reads it through
+		// whichever window it has current once the frame is drawn
+		if (context.render)
+			waitForFrame(context);
+		else if (glfwGetCurrentContext() != context.window)
+			glfwMakeContextCurrent(context.window);
+
+		image.width = context.frameWidth;
+		image.height = context.frameHeight;
+		image.pixels.resize((size_t)image.width * image.height * 4);
+
+		glBindTexture(GL_TEXTURE_2D, context.frameTexture);
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+
+		// OpenGL rows start at the bottom
+		size_t rowBytes = (size_t)image.width * 4;
+		for (int row = 0; row < image.height / 2; row++)
+		{
+			unsigned char* top = image.pixels.data() + row * rowBytes;
+			unsigned char* bottom = image.pixels.data() + (image.height - 1 - row) * rowBytes;
+			std::swap_ranges(top, top + rowBytes, bottom);
+		}
+
+		return true;
+	}
+
+	unsigned char Context::getKey() const
 	{
+		GLFWwindow* window = m_data->window;
 		unsigned char key = 0;	// none
 
-		if (glfwGetKey(s_window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+		if (!window)
+			return key;
+
+		if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 			key = 0x1B; // ESC
-		else if (glfwGetKey(s_window, GLFW_KEY_X) == GLFW_PRESS)
+		else if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS)
 			key = 'X';
-		else if (glfwGetKey(s_window, GLFW_KEY_W) == GLFW_PRESS)
+		else if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
 			key = 'W';
-		else if (glfwGetKey(s_window, GLFW_KEY_S) == GLFW_PRESS)
+		else if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
 			key = 'S';
-		else if (glfwGetKey(s_window, GLFW_KEY_A) == GLFW_PRESS)
+		else if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
 			key = 'A';
-		else if (glfwGetKey(s_window, GLFW_KEY_D) == GLFW_PRESS)
+		else if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 			key = 'D';
-		else if (glfwGetKey(s_window, GLFW_KEY_UP) == GLFW_PRESS)
+		else if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
 			key = 'W';
-		else if (glfwGetKey(s_window, GLFW_KEY_DOWN) == GLFW_PRESS)
+		else if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
 			key = 'S';
-		else if (glfwGetKey(s_window, GLFW_KEY_LEFT) == GLFW_PRESS)
+		else if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
 			key = 'A';
-		else if (glfwGetKey(s_window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+		else if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
 			key = 'D';
 
 		return key;
 	}
 
-	void getEvents()
+	GLFWwindow* Context::window() const
 	{
-		// poll for and process events
-		glfwPollEvents();
+		return m_data->window;
 	}
 
-	void cleanup()
+	void Context::setLayer(int layer)
 	{
-		glfwTerminate();
+		if (layer < -32768)
+			layer = -32768;
+		else if (layer > 32767)
+			layer = 32767;
+
+		m_data->batch.layer = layer;
+		updateDepth(m_data->batch);
 	}
 
+	int Context::getLayer() const
+	{
+		return m_data->batch.layer;
+	}
 
-	void drawQuad(float x, float y, float width, float height, unsigned int color)
+	void Context::setDepth(float depth)
 	{
-		GLfloat vertices[] =
-		{
-			 x        , y         , 	// bottom left corner
-			 x + width, y         , 	// bottom Right corner
-			 x + width, y + height, 	// top right corner
-			 x        , y + height  	// top left corner
-		};
+		if (depth < 0)
+			depth = 0;
+		else if (depth > 1)
+			depth = 1;
 
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glVertexPointer(2, GL_FLOAT, 0, vertices);
-		setColor(color);
-		glDrawArrays(GL_QUADS, 0, 4);
-		glDisableClientState(GL_VERTEX_ARRAY);
+		m_data->batch.depth = depth;
+		updateDepth(m_data->batch);
+	}
 
+	float Context::getDepth() const
+	{
+		return m_data->batch.depth;
 	}
 
-	void drawPoint(float x, float y, float size, unsigned int color, bool smooth)
+	void Context::setBlendMode(int mode)
 	{
-		GLfloat pointVertex[] = { x, y };
+		if (mode < BlendOpaque || mode > BlendMultiply)
+			mode = BlendOpaque;
 
-		glPushAttrib(GL_POINT_BIT);
-		if (smooth)
-			glEnable(GL_POINT_SMOOTH);
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glPointSize(size);
-		glVertexPointer(2, GL_FLOAT, 0, pointVertex);
-		setColor(color);
-		glDrawArrays(GL_POINTS, 0, 1);
-		glDisableClientState(GL_VERTEX_ARRAY);
-		if (smooth)
-			glDisable(GL_POINT_SMOOTH);
-		glPopAttrib();
+		m_data->batch.blend = mode;
 	}
 
-	void drawLine(float x1, float y1, float x2, float y2, float width, unsigned int color, bool smooth)
+	int Context::getBlendMode() const
 	{
-		GLfloat lineVertices[] = {
-			x1, y1,
-			x2, y2
-		};
+		return m_data->batch.blend;
+	}
 
+	FrameArena& Context::getFrameArena()
+	{
+		return m_data->arena;
+	}
 
-		glPushAttrib(GL_LINE_BIT);
-		if (smooth)
-			glEnable(GL_LINE_SMOOTH);
-		glLineWidth(width);
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glVertexPointer(2, GL_FLOAT, 0, lineVertices);
-		setColor(color);
-		glDrawArrays(GL_LINES, 0, 2);
-		glDisableClientState(GL_VERTEX_ARRAY);
-		if (smooth)
-			glDisable(GL_LINE_SMOOTH);
-		glPopAttrib(); // restore line attributes
+	FrameStats Context::getFrameStats() const
+	{
+		return m_data->batch.stats;
+	}
+	void Context::drawQuad(float x, float y, float width, float height, unsigned int color)
+	{
+		batchQuad(m_data->batch, x, y, width, height, color);
 	}
 
-	void drawCircle(float x, float y, float radius, unsigned int color, int sides)
+	void Context::drawPoint(float x, float y, float size, unsigned int color, bool smooth)
 	{
-		GLint numberOfVertices = sides + 2;
+		batchPoint(m_data->batch, x, y, size, color, smooth);
+	}
 
-		GLfloat doublePi = 2.0f * M_PI;
+	void Context::drawLine(float x1, float y1, float x2, float y2, float width, unsigned int color, bool smooth)
+	{
+		batchLine(m_data->batch, x1, y1, x2, y2, width, color, smooth);
+	}
 
-		GLfloat* circleVerticesX = new GLfloat[numberOfVertices];
-		GLfloat* circleVerticesY = new GLfloat[numberOfVertices];
+	void Context::drawPolyline(const Point* points, int count, float width, unsigned int color, int join, int cap,
+		bool closed)
+	{
+		batchPolyline(m_data->batch, points, count, width, color, join, cap, closed);
+	}
 
-		circleVerticesX[0] = x;
-		circleVerticesY[0] = y;
+	void Context::drawPolygon(const Point* points, int count, unsigned int color)
+	{
+		batchPolygon(m_data->batch, points, count, color);
+	}
 
-		for (int i = 1; i < numberOfVertices; i++)
-		{
-			circleVerticesX[i] = x + (radius * cos(i * doublePi / sides));
-			circleVerticesY[i] = y + (radius * sin(i * doublePi / sides));
-		}
+	void Context::drawPolygonOutline(const Point* points, int count, float width, unsigned int color, int join)
+	{
+		batchPolyline(m_data->batch, points, count, width, color, join, CapButt, true);
+	}
 
-		GLfloat* allCircleVertices = new GLfloat[numberOfVertices * 2];
+	void Context::drawQuad(float x, float y, float width, float height, unsigned int bottomLeft,
+		unsigned int bottomRight, unsigned int topRight, unsigned int topLeft)
+	{
+		batchGradientQuad(m_data->batch, x, y, width, height, bottomLeft, bottomRight, topRight, topLeft);
+	}
 
-		for (int i = 0; i < numberOfVertices; i++)
-		{
-			allCircleVertices[i * 2] = circleVerticesX[i];
-			allCircleVertices[(i * 2) + 1] = circleVerticesY[i];
-		}
+	void Context::drawCircle(float x, float y, float radius, unsigned int color, int sides)
+	{
+		batchCircle(m_data->batch, x, y, radius, color, color, sides);
+	}
 
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glVertexPointer(2, GL_FLOAT, 0, allCircleVertices);
-		setColor(color);
-		glDrawArrays(GL_TRIANGLE_FAN, 0, numberOfVertices);
-		glDisableClientState(GL_VERTEX_ARRAY);
+	void Context::drawGradientCircle(float x, float y, float radius, unsigned int centerColor, unsigned int edgeColor,
+		int sides)
+	{
+		batchCircle(m_data->batch, x, y, radius, centerColor, edgeColor, sides);
+	}
 
-		delete[] circleVerticesX;
-		delete[] circleVerticesY;
-		delete[] allCircleVertices;
+	void Context::drawText(float x, float y, std::string_view text, int size, unsigned int color)
+	{
+		batchText(m_data->batch, x, y, text, size, color);
 	}
 
-	void drawText(float x, float y, std::string text, int size, unsigned int color)
+	void Context::drawText(float x, float y, const TextBlock& block)
 	{
-		GLfloat xpos, ypos;
+		if (block.m_data)
+			batchTextBlock(m_data->batch, x, y, *block.m_data);
+	}
 
-		for (int c = 0; c < text.length(); c++)
-		{
-			ypos = y + 8;
-			for (int i = 0; i < 8; i++)
-			{
-				xpos = x;
-				GLubyte byte = CHARACTERS[text[c] - 32][i];
-				for (int b = 0; b < 8; b++)
-				{
-					if (byte & 0x80)
-					{
-						for (GLfloat ys = ypos; ys < ypos + size; ys++)
-						{
-							for (GLfloat xs = xpos; xs < xpos + size; xs++)
-							{
-								drawPoint(xs, ys, 1, color);
-							}
-						}
-					}
-					byte = byte << 1;
-					xpos += size;
-				}
-				ypos -= size;
-			}
-			x = xpos;
-		}
+	void Context::drawTextBox(const Rect& box, std::string_view text, int size, unsigned int color, int align, bool wrap)
+	{
+		batchTextBox(m_data->batch, box, text, size, color, align, wrap);
 	}
 
-	//-----------------------------------------------------------------------------
-	// GLFW function declarations
-	//-----------------------------------------------------------------------------
+	void Context::drawText(float x, float y, std::string_view text, const SdfFont& font, float scale,
+		float rotation, unsigned int color)
+	{
+		batchSdfText(m_data->batch, x, y, text, font, scale, rotation, color);
+	}
 
-	/**
-	 callback function that keep the viewport size in sync with changes user makes
-	 to the displayed window
-	 parameters:
-		window		- pointer to the GLFW window object
-		width		- new width of the window on the screen
-		height		- new height of the window on the screen
-	 returns:
-		void
-	 */
-	void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+	void Context::drawText(float x, float y, std::string_view text, const BitmapFont& font, int size, unsigned int color)
 	{
-		// make sure the viewport matches the new window dimensions; note that width and 
-		// height will be significantly larger than specified on retina displays.
-		glViewport(0, 0, width, height);
+		batchFontText(m_data->batch, x, y, text, font, size, color);
 	}
 
+	void Context::drawNumber(float x, float y, long long value, int size, unsigned int color)
+	{
+		char buffer[FORMAT_BUFFER_SIZE];
+		size_t length = formatNumber(buffer, value);
 
-	//-----------------------------------------------------------------------------
-	// private functions
-	//-----------------------------------------------------------------------------
+		batchText(m_data->batch, x, y, std::string_view(buffer, length), size, color);
+	}
+
+	void Context::drawFormatted(float x, float y, int size, unsigned int color, const char* format, ...)
+	{
+		char buffer[FORMAT_BUFFER_SIZE];
+		va_list args;
+
+		va_start(args, format);
+		size_t length = formatText(buffer, sizeof(buffer), format, args);
+		va_end(args);
+
+		batchText(m_data->batch, x, y, std::string_view(buffer, length), size, color);
+	}
+
+	void Context::drawSprite(const Texture& texture, float x, float y, float width, float height,
+		float rotation, unsigned int tint, int flip)
+	{
+		batchSprite(m_data->batch, texture, nullptr, x, y, width, height, rotation, tint, flip);
+	}
+
+	void Context::drawSprite(const Texture& texture, const Rect& source, float x, float y, float width, float height,
+		float rotation, unsigned int tint, int flip)
+	{
+		batchSprite(m_data->batch, texture, &source, x, y, width, height, rotation, tint, flip);
+	}
+
+	//-----------------------------------------------------------------------------
+	// CommandList
+	//-----------------------------------------------------------------------------
+
+	CommandList::CommandList(Context& context) : m_data(new CommandListData)
+	{
+		m_data->context = context.m_data.get();
+
+		// record in depth buffer order whatever the context uses,
+		// mergeCommandLists converts it
+		m_data->recording.deferTextures = true;
+		m_data->recording.depthBuffer = true;
+		m_data->submitted.deferTextures = true;
+		updateDepth(m_data->recording);
+
+		std::lock_guard<std::mutex> lock(m_data->context->listMutex);
+		m_data->context->lists.push_back(m_data.get());
+	}
+
+	CommandList::~CommandList()
+	{
+		std::lock_guard<std::mutex> lock(m_data->context->listMutex);
+		std::vector<CommandListData*>& lists = m_data->context->lists;
+		lists.erase(std::find(lists.begin(), lists.end(), m_data.get()));
+	}
+
+	void CommandList::submit()
+	{
+		FrameBatch& recording = m_data->recording;
+		FrameBatch& submitted = m_data->submitted;
+
+		if (recording.commands.empty())
+			return;
+
+		std::lock_guard<std::mutex> lock(m_data->context->listMutex);
+
+		// trade buffers so neither side allocates once both have grown,
+		// append when the last submit has not been painted yet
+		if (submitted.commands.empty())
+		{
+			submitted.vertices.swap(recording.vertices);
+			submitted.indices.swap(recording.indices);
+			submitted.commands.swap(recording.commands);
+			submitted.states.swap(recording.states);
+			submitted.fixups.swap(recording.fixups);
+			std::swap(submitted.sharedStates, recording.sharedStates);
+		}
+		else
+		{
+			appendBatch(submitted, recording, m_data->stateMap);
+		}
+
+		resetBatch(recording);
+	}
+
+	void CommandList::clear()
+	{
+		resetBatch(m_data->recording);
+	}
+
+	void CommandList::setLayer(int layer)
+	{
+		if (layer < -32768)
+			layer = -32768;
+		else if (layer > 32767)
+			layer = 32767;
+
+		m_data->recording.layer = layer;
+		updateDepth(m_data->recording);
+	}
+
+	int CommandList::getLayer() const
+	{
+		return m_data->recording.layer;
+	}
+
+	void CommandList::setDepth(float depth)
+	{
+		if (depth < 0)
+			depth = 0;
+		else if (depth > 1)
+			depth = 1;
+
+		m_data->recording.depth = depth;
+		updateDepth(m_data->recording);
+	}
+
+	float CommandList::getDepth() const
+	{
+		return m_data->recording.depth;
+	}
+
+	void CommandList::setBlendMode(int mode)
+	{
+		if (mode < BlendOpaque || mode > BlendMultiply)
+			mode = BlendOpaque;
+
+		m_data->recording.blend = mode;
+	}
+
+	int CommandList::getBlendMode() const
+	{
+		return m_data->recording.blend;
+	}
+
+	void CommandList::drawQuad(float x, float y, float width, float height, unsigned int color)
+	{
+		batchQuad(m_data->recording, x, y, width, height, color);
+	}
+
+	void CommandList::drawPoint(float x, float y, float size, unsigned int color, bool smooth)
+	{
+		batchPoint(m_data->recording, x, y, size, color, smooth);
+	}
+
+	void CommandList::drawLine(float x1, float y1, float x2, float y2, float width, unsigned int color, bool smooth)
+	{
+		batchLine(m_data->recording, x1, y1, x2, y2, width, color, smooth);
+	}
+
+	void CommandList::drawPolyline(const Point* points, int count, float width, unsigned int color, int join, int cap,
+		bool closed)
+	{
+		batchPolyline(m_data->recording, points, count, width, color, join, cap, closed);
+	}
+
+	void CommandList::drawPolygon(const Point* points, int count, unsigned int color)
+	{
+		batchPolygon(m_data->recording, points, count, color);
+	}
+
+	void CommandList::drawPolygonOutline(const Point* points, int count, float width, unsigned int color, int join)
+	{
+		batchPolyline(m_data->recording, points, count, width, color, join, CapButt, true);
+	}
+
+	void CommandList::drawQuad(float x, float y, float width, float height, unsigned int bottomLeft,
+		unsigned int bottomRight, unsigned int topRight, unsigned int topLeft)
+	{
+		batchGradientQuad(m_data->recording, x, y, width, height, bottomLeft, bottomRight, topRight, topLeft);
+	}
+
+	void CommandList::drawCircle(float x, float y, float radius, unsigned int color, int sides)
+	{
+		batchCircle(m_data->recording, x, y, radius, color, color, sides);
+	}
+
+	void CommandList::drawGradientCircle(float x, float y, float radius, unsigned int centerColor, unsigned int edgeColor,
+		int sides)
+	{
+		batchCircle(m_data->recording, x, y, radius, centerColor, edgeColor, sides);
+	}
+
+	void CommandList::drawText(float x, float y, std::string_view text, int size, unsigned int color)
+	{
+		batchText(m_data->recording, x, y, text, size, color);
+	}
+
+	void CommandList::drawText(float x, float y, const TextBlock& block)
+	{
+		if (block.m_data)
+			batchTextBlock(m_data->recording, x, y, *block.m_data);
+	}
+
+	void CommandList::drawTextBox(const Rect& box, std::string_view text, int size, unsigned int color, int align, bool wrap)
+	{
+		batchTextBox(m_data->recording, box, text, size, color, align, wrap);
+	}
+
+	void CommandList::drawText(float x, float y, std::string_view text, const SdfFont& font, float scale,
+		float rotation, unsigned int color)
+	{
+		batchSdfText(m_data->recording, x, y, text, font, scale, rotation, color);
+	}
+
+	void CommandList::drawText(float x, float y, std::string_view text, const BitmapFont& font, int size, unsigned int color)
+	{
+		batchFontText(m_data->recording, x, y, text, font, size, color);
+	}
+
+	void CommandList::drawNumber(float x, float y, long long value, int size, unsigned int color)
+	{
+		char buffer[FORMAT_BUFFER_SIZE];
+		size_t length = formatNumber(buffer, value);
+
+		batchText(m_data->recording, x, y, std::string_view(buffer, length), size, color);
+	}
+
+	void CommandList::drawFormatted(float x, float y, int size, unsigned int color, const char* format, ...)
+	{
+		char buffer[FORMAT_BUFFER_SIZE];
+		va_list args;
+
+		va_start(args, format);
+		size_t length = formatText(buffer, sizeof(buffer), format, args);
+		va_end(args);
+
+		batchText(m_data->recording, x, y, std::string_view(buffer, length), size, color);
+	}
+
+	void CommandList::drawSprite(const Texture& texture, float x, float y, float width, float height,
+		float rotation, unsigned int tint, int flip)
+	{
+		batchSprite(m_data->recording, texture, nullptr, x, y, width, height, rotation, tint, flip);
+	}
+
+	void CommandList::drawSprite(const Texture& texture, const Rect& source, float x, float y, float width, float height,
+		float rotation, unsigned int tint, int flip)
+	{
+		batchSprite(m_data->recording, texture, &source, x, y, width, height, rotation, tint, flip);
+	}
+
+	//-----------------------------------------------------------------------------
+	// TextBlock
+	//-----------------------------------------------------------------------------
+
+	TextBlock::TextBlock() : m_data(new TextBlockData)
+	{
+	}
+
+	TextBlock::TextBlock(std::string_view text, int size, unsigned int color) : m_data(new TextBlockData)
+	{
+		m_data->text = text;
+		m_data->size = size;
+		m_data->color = color;
+		layoutTextBlock(*m_data);
+	}
+
+	TextBlock::~TextBlock() = default;
+
+	// the block moved from keeps no data, reads as empty and allocates
+	// again when it is next given text, size or color
+	TextBlock::TextBlock(TextBlock&& other) noexcept = default;
+	TextBlock& TextBlock::operator=(TextBlock&& other) noexcept = default;
+
+	void TextBlock::setText(std::string_view text)
+	{
+		if (text == getText())
+			return;
+
+		if (!m_data)
+			m_data.reset(new TextBlockData);
+		m_data->text = text;
+		layoutTextBlock(*m_data);
+	}
+
+	void TextBlock::setSize(int size)
+	{
+		if (size == getSize())
+			return;
+
+		if (!m_data)
+			m_data.reset(new TextBlockData);
+		m_data->size = size;
+		layoutTextBlock(*m_data);
+	}
+
+	void TextBlock::setColor(unsigned int color)
+	{
+		if (color == getColor())
+			return;
+
+		if (!m_data)
+			m_data.reset(new TextBlockData);
+		m_data->color = color;
+
+		PackedColor packed = packColor(color);
+		for (Vertex& vertex : m_data->vertices)
+			vertex.color = packed;
+	}
+
+	std::string_view TextBlock::getText() const
+	{
+		return m_data ? std::string_view(m_data->text) : std::string_view();
+	}
+
+	int TextBlock::getSize() const
+	{
+		return m_data ? m_data->size : 1;
+	}
+
+	unsigned int TextBlock::getColor() const
+	{
+		return m_data ? m_data->color : (unsigned int)White;
+	}
+
+	Rect TextBlock::getBounds() const
+	{
+		if (!m_data)
+			return Rect();
+
+		int size = m_data->size;
+
+		if (m_data->text.empty() || size <= 0)
+			return Rect();
+
+		// rows are drawn from 8 above y downwards, each size pixels tall
+		return { 0, (float)(8 - 7 * size), (float)(8 * size * m_data->text.size()), (float)(8 * size) };
+	}
+
+	//-----------------------------------------------------------------------------
+	// default context
+	//-----------------------------------------------------------------------------
+
+	Context& defaultContext()
+	{
+		static Context context;
+		return context;
+	}
+
+	void openWindow(int width, int height, const std::string& title, bool resizable)
+	{
+		openWindow(width, height, title.c_str(), resizable);
+	}
+
+	void openWindow(int width, int height, const char* title, bool resizable)
+	{
+		WindowOptions options;
+		options.resizable = resizable;
+
+		defaultContext().open(width, height, title, options);
+	}
+
+	void openWindow(int width, int height, const std::string& title, const WindowOptions& options)
+	{
+		defaultContext().open(width, height, title.c_str(), options);
+	}
+
+	void openWindow(int width, int height, const char* title, const WindowOptions& options)
+	{
+		defaultContext().open(width, height, title, options);
+	}
+
+	bool windowClosing()
+	{
+		return defaultContext().closing();
+	}
+
+	void windowPaint()
+	{
+		defaultContext().paint();
+		endJobFrame();
+		endAllocationFrame();
+	}
+
+	bool readFrame(Image& image)
+	{
+		return defaultContext().readFrame(image);
+	}
+
+	double getTime()
+	{
+		return glfwGetTime();
+	}
+
+	unsigned char getKey()
+	{
+		return defaultContext().getKey();
+	}
+
+	void getEvents()
+	{
+		// poll for and process events
+		glfwPollEvents();
+	}
+
+	void cleanup()
+	{
+		while (!s_contexts.empty())
+			closeContext(*s_contexts.back());
+
+		s_loader.stop();
+		stopJobs();
+		glfwTerminate();
+	}
+
+	void setLayer(int layer)
+	{
+		defaultContext().setLayer(layer);
+	}
+
+	int getLayer()
+	{
+		return defaultContext().getLayer();
+	}
+
+	void setDepth(float depth)
+	{
+		defaultContext().setDepth(depth);
+	}
+
+	float getDepth()
+	{
+		return defaultContext().getDepth();
+	}
+
+	void setBlendMode(int mode)
+	{
+		defaultContext().setBlendMode(mode);
+	}
+
+	int getBlendMode()
+	{
+		return defaultContext().getBlendMode();
+	}
+
+	FrameStats getFrameStats()
+	{
+		return defaultContext().getFrameStats();
+	}
+
+	FrameArena& getFrameArena()
+	{
+		return defaultContext().getFrameArena();
+	}
+
+	void drawQuad(float x, float y, float width, float height, unsigned int color)
+	{
+		defaultContext().drawQuad(x, y, width, height, color);
+	}
+
+	void drawPoint(float x, float y, float size, unsigned int color, bool smooth)
+	{
+		defaultContext().drawPoint(x, y, size, color, smooth);
+	}
+
+	void drawLine(float x1, float y1, float x2, float y2, float width, unsigned int color, bool smooth)
+	{
+		defaultContext().drawLine(x1, y1, x2, y2, width, color, smooth);
+	}
+
+	void drawPolyline(const Point* points, int count, float width, unsigned int color, int join, int cap, bool closed)
+	{
+		defaultContext().drawPolyline(points, count, width, color, join, cap, closed);
+	}
+
+	void drawPolygon(const Point* points, int count, unsigned int color)
+	{
+		defaultContext().drawPolygon(points, count, color);
+	}
+
+	void drawPolygonOutline(const Point* points, int count, float width, unsigned int color, int join)
+	{
+		defaultContext().drawPolygonOutline(points, count, width, color, join);
+	}
+
+	void drawQuad(float x, float y, float width, float height, unsigned int bottomLeft, unsigned int bottomRight,
+		unsigned int topRight, unsigned int topLeft)
+	{
+		defaultContext().drawQuad(x, y, width, height, bottomLeft, bottomRight, topRight, topLeft);
+	}
+
+	void drawCircle(float x, float y, float radius, unsigned int color, int sides)
+	{
+		defaultContext().drawCircle(x, y, radius, color, sides);
+	}
+
+	void drawGradientCircle(float x, float y, float radius, unsigned int centerColor, unsigned int edgeColor,
+		int sides)
+	{
+		defaultContext().drawGradientCircle(x, y, radius, centerColor, edgeColor, sides);
+	}
+
+	void drawText(float x, float y, std::string_view text, int size, unsigned int color)
+	{
+		defaultContext().drawText(x, y, text, size, color);
+	}
+
+	void drawText(float x, float y, const TextBlock& block)
+	{
+		defaultContext().drawText(x, y, block);
+	}
+
+	TextMetrics measureText(std::string_view text, int size, float wrapWidth)
+	{
+		if (size <= 0)
+			return TextMetrics();
+
+		std::lock_guard<std::mutex> lock(s_layouts.mutex);
+		const TextLayout& layout = findLayout(text, wrapColumns(wrapWidth, size));
+		int lines = (int)layout.lines.size();
+
+		return { (float)(8 * size * layout.widest), (float)(8 * size * lines), lines };
+	}
+
+	void drawTextBox(const Rect& box, std::string_view text, int size, unsigned int color, int align, bool wrap)
+	{
+		defaultContext().drawTextBox(box, text, size, color, align, wrap);
+	}
+
+	void drawText(float x, float y, std::string_view text, const SdfFont& font, float scale,
+		float rotation, unsigned int color)
+	{
+		defaultContext().drawText(x, y, text, font, scale, rotation, color);
+	}
+
+	void drawText(float x, float y, std::string_view text, const BitmapFont& font, int size, unsigned int color)
+	{
+		defaultContext().drawText(x, y, text, font, size, color);
+	}
+
+	void drawNumber(float x, float y, long long value, int size, unsigned int color)
+	{
+		defaultContext().drawNumber(x, y, value, size, color);
+	}
+
+	void drawFormatted(float x, float y, int size, unsigned int color, const char* format, ...)
+	{
+		char buffer[FORMAT_BUFFER_SIZE];
+		va_list args;
+
+		va_start(args, format);
+		size_t length = formatText(buffer, sizeof(buffer), format, args);
+		va_end(args);
+
+		defaultContext().drawText(x, y, std::string_view(buffer, length), size, color);
+	}
+
+	void drawSprite(const Texture& texture, float x, float y, float width, float height,
+		float rotation, unsigned int tint, int flip)
+	{
+		defaultContext().drawSprite(texture, x, y, width, height, rotation, tint, flip);
+	}
+
+	void drawSprite(const Texture& texture, const Rect& source, float x, float y, float width, float height,
+		float rotation, unsigned int tint, int flip)
+	{
+		defaultContext().drawSprite(texture, source, x, y, width, height, rotation, tint, flip);
+	}
+
+	Texture loadTexture(const unsigned char* pixels, int width, int height, bool smooth)
+	{
+		Texture texture;
+
+		if (!pixels || width <= 0 || height <= 0)
+			return texture;
+
+		texture.id = addTextureSlot(createImageTexture(pixels, width, height, smooth));
+		texture.width = width;
+		texture.height = height;
+		return texture;
+	}
+
+	Texture loadTexture(const std::string& filename, bool smooth)
+	{
+		return loadTexture(filename.c_str(), smooth);
+	}
+
+	Texture loadTexture(const char* filename, bool smooth)
+	{
+		Image image;
+
+		if (!loadImage(filename, image))
+			return Texture();
+
+		return loadTexture(image.pixels.data(), image.width, image.height, smooth);
+	}
+
+	Texture loadTexture(AssetPack pack, std::string_view name, bool smooth)
+	{
+		Asset asset;
+
+		if (!findAsset(pack, name, asset) || asset.type != PackImage)
+			return Texture();
+
+		return loadTexture(asset.data, asset.width, asset.height, smooth);
+	}
+
+	Texture loadTextureAsync(const std::string& filename, bool smooth)
+	{
+		return loadTextureAsync(filename.c_str(), smooth);
+	}
+
+	Texture loadTextureAsync(const char* filename, bool smooth)
+	{
+		Texture texture;
+		std::unique_ptr<LoadJob> job(new LoadJob);
+
+		job->type = LoadImageFile;
+		job->filename = filename;
+		job->smooth = smooth;
+		job->texture = texture.id = reserveTextureSlot();
+
+		startLoad(std::move(job));
+		return texture;
+	}
+
+	Texture loadTextureAsync(AssetPack pack, std::string_view name, bool smooth)
+	{
+		Texture texture;
+		std::unique_ptr<LoadJob> job(new LoadJob);
+
+		// the pack may still be loading, it is searched when the upload starts
+		job->type = LoadPackImage;
+		job->pack = pack;
+		job->name = name;
+		job->smooth = smooth;
+		job->texture = texture.id = reserveTextureSlot();
+
+		startLoad(std::move(job));
+		return texture;
+	}
+
+	AssetPack openPackAsync(const std::string& filename)
+	{
+		return openPackAsync(filename.c_str());
+	}
+
+	AssetPack openPackAsync(const char* filename)
+	{
+		AssetPack pack = reservePack();
+		std::unique_ptr<LoadJob> job(new LoadJob);
+
+		job->type = LoadPackFile;
+		job->filename = filename;
+		job->pack = pack;
+
+		startLoad(std::move(job));
+		return pack;
+	}
+
+	bool textureReady(Texture& texture)
+	{
+		const TextureSlot* slot = findTexture(texture.id);
+		if (!slot)
+			return false;
+
+		// async handles are 0 by 0 until now
+		if (texture.width == 0 && texture.height == 0)
+		{
+			texture.width = slot->width - slot->originX;
+			texture.height = slot->height - slot->originY;
+		}
+		return true;
+	}
+
+	int pendingLoads()
+	{
+		return s_loader.pending;
+	}
+
+	void setUploadBudget(int bytes, double milliseconds)
+	{
+		s_loader.budgetBytes = bytes > 0 ? (size_t)bytes : 0;
+		s_loader.budgetSeconds = milliseconds > 0 ? milliseconds / 1000.0 : 0;
+	}
+
+	Texture subTexture(const Texture& texture, int x, int y, int width, int height)
+	{
+		Texture region = texture;
+		region.x += x;
+		region.y += y;
+		region.width = width;
+		region.height = height;
+		return region;
+	}
+
+	void freeTexture(Texture& texture)
+	{
+		const TextureSlot* slot = findTexture(texture.id);
+
+		// a loading slot is released when its load finishes, atlas pages
+		// are shared by every image on them and stay until freeAtlas
+		if (!slot && textureLoading(texture.id))
+			s_textures[texture.id - 1].freed = true;
+		else if (slot && !slot->atlasPage)
+			releaseTextureSlot(texture.id);
+
+		texture = Texture();
+	}
+
+	TextureAtlas createAtlas(int pageSize, int padding, bool smooth)
+	{
+		TextureAtlas atlas;
+
+		// reuse a released slot before growing the table
+		size_t slot = 0;
+		while (slot < s_atlases.size() && s_atlases[slot].pageSize != 0)
+			slot++;
+		if (slot == s_atlases.size())
+			s_atlases.push_back({});
+
+		AtlasData& data = s_atlases[slot];
+		data.pageSize = pageSize > 0 ? pageSize : 1;
+		data.padding = padding > 0 ? padding : 0;
+		data.smooth = smooth;
+		data.pages.clear();
+
+		atlas.id = (unsigned int)slot + 1;
+		return atlas;
+	}
+
+	Texture atlasAdd(TextureAtlas atlas, const unsigned char* pixels, int width, int height)
+	{
+		if (atlas.id == 0 || atlas.id > s_atlases.size() || s_atlases[atlas.id - 1].pageSize == 0)
+			return Texture();
+		if (!pixels || width <= 0 || height <= 0)
+			return Texture();
+
+		AtlasData& data = s_atlases[atlas.id - 1];
+		int paddedWidth = width + 2 * data.padding;
+		int paddedHeight = height + 2 * data.padding;
+
+		// must fit on an empty page beside the white texel in the corner
+		int corner = 1 + data.padding;
+		if (paddedWidth > data.pageSize || paddedHeight > data.pageSize
+			|| (paddedWidth + corner > data.pageSize && paddedHeight + corner > data.pageSize))
+			return loadTexture(pixels, width, height, data.smooth);
+
+		// drop pages whose texture is gone, e.g. with the last window closed
+		data.pages.erase(std::remove_if(data.pages.begin(), data.pages.end(), [](const AtlasPage& page) {
+			const TextureSlot* slot = findTexture(page.texture);
+			return !slot || !slot->atlasPage || slot->width <= 0;
+		}), data.pages.end());
+
+		// first fit in page order, growing a page before moving on
+		AtlasPage* page = nullptr;
+		int x = 0, y = 0;
+
+		for (size_t i = 0; i < data.pages.size() && !page; i++)
+		{
+			AtlasPage& candidate = data.pages[i];
+			for (;;)
+			{
+				int size = s_textures[candidate.texture - 1].width;
+
+				if (skylinePack(candidate.skyline, size, paddedWidth, paddedHeight, x, y))
+				{
+					page = &candidate;
+					break;
+				}
+				if (size >= data.pageSize)
+					break;
+
+				growAtlasPage(data, candidate);
+			}
+		}
+
+		// a new page grows until the image fits, checked above that it will
+		if (!page)
+		{
+			page = addAtlasPage(data);
+			while (!skylinePack(page->skyline, s_textures[page->texture - 1].width,
+				paddedWidth, paddedHeight, x, y))
+				growAtlasPage(data, *page);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, s_textures[page->texture - 1].name);
+		uploadPadded(pixels, x + data.padding, y + data.padding, width, height, data.padding);
+
+		Texture texture;
+		texture.id = page->texture;
+		texture.x = x + data.padding;
+		texture.y = y + data.padding;
+		texture.width = width;
+		texture.height = height;
+		return texture;
+	}
+
+	Texture atlasAdd(TextureAtlas atlas, const std::string& filename)
+	{
+		return atlasAdd(atlas, filename.c_str());
+	}
+
+	Texture atlasAdd(TextureAtlas atlas, const char* filename)
+	{
+		Image image;
+
+		if (!loadImage(filename, image))
+			return Texture();
+
+		return atlasAdd(atlas, image.pixels.data(), image.width, image.height);
+	}
+
+	void freeAtlas(TextureAtlas& atlas)
+	{
+		if (atlas.id != 0 && atlas.id <= s_atlases.size())
+		{
+			AtlasData& data = s_atlases[atlas.id - 1];
+
+			for (AtlasPage& page : data.pages)
+			{
+				if (findTexture(page.texture))
+					releaseTextureSlot(page.texture);
+			}
+
+			data.pages.clear();
+			data.pageSize = 0;
+		}
+
+		atlas = TextureAtlas();
+	}
+
+	SdfFont createSdfFont()
+	{
+		std::vector<uint8_t> glyphs(CHARACTER_COUNT * 8 * 8);
+
+		// rows top to bottom, the high bit is the left pixel
+		for (int glyph = 0; glyph < CHARACTER_COUNT; glyph++)
+			for (int row = 0; row < 8; row++)
+				for (int bit = 0; bit < 8; bit++)
+					glyphs[(glyph * 8 + row) * 8 + bit] = (CHARACTERS[glyph][row] >> (7 - bit)) & 1;
+
+		return buildSdfFont(glyphs, 8, 8, CHARACTER_COUNT, 32);
+	}
+
+	SdfFont createSdfFont(const Image& image, int glyphWidth, int glyphHeight, int first)
+	{
+		if (glyphWidth <= 0 || glyphHeight <= 0)
+			return SdfFont();
+
+		int columns = image.width / glyphWidth;
+		int count = columns * (image.height / glyphHeight);
+		if (count == 0)
+			return SdfFont();
+
+		std::vector<uint8_t> glyphs(count * glyphWidth * glyphHeight);
+		for (int glyph = 0; glyph < count; glyph++)
+		{
+			int left = glyph % columns * glyphWidth;
+			int top = glyph / columns * glyphHeight;
+			for (int y = 0; y < glyphHeight; y++)
+				for (int x = 0; x < glyphWidth; x++)
+				{
+					unsigned char alpha = image.pixels[((top + y) * image.width + left + x) * 4 + 3];
+					glyphs[(glyph * glyphHeight + y) * glyphWidth + x] = alpha >= 128;
+				}
+		}
+
+		return buildSdfFont(glyphs, glyphWidth, glyphHeight, count, first);
+	}
+
+	void freeSdfFont(SdfFont& font)
+	{
+		freeTexture(font.texture);
+		font = SdfFont();
+	}
+
+	//-----------------------------------------------------------------------------
+	// GLFW function declarations
+	//-----------------------------------------------------------------------------
+
+	/**
+	 callback function that keep the viewport size in sync with changes user makes
+	 to the displayed window
+	 parameters:
+		window		- pointer to the GLFW window object
+		width		- new width of the window on the screen
+		height		- new height of the window on the screen
+	 returns:
+		void
+	 */
+	void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+	{
+		// make sure the viewport matches the new window dimensions; note that width and 
+		// height will be significantly larger than specified on retina displays.
+		// the window may not be the current context, so paint sets the viewport
+		ContextData* context = (ContextData*)glfwGetWindowUserPointer(window);
+		context->viewportWidth = width;
+		context->viewportHeight = height;
+		context->viewportChanged = true;
+	}
+
+
+	//-----------------------------------------------------------------------------
+	// private functions
+	//-----------------------------------------------------------------------------
+
+	/**
+	 Convert an integer color to the byte layout used by the vertex
+	 color array, no floating point conversion needed
+	 Parameters
+		color - 0xTTRRGGBB, transparency in the top byte, see Color
+	*/
+	PackedColor packColor(unsigned int color)
+	{
+		PackedColor packed;
+		packed.red = (GLubyte)(color >> 16);
+		packed.green = (GLubyte)(color >> 8);
+		packed.blue = (GLubyte)color;
+		packed.alpha = (GLubyte)(0xFF - (color >> 24));
+		return packed;
+	}
+
+	/**
+	 Create an empty RGBA OpenGL texture and leave it bound
+	 Parameters
+		width	- in pixels
+		height	- in pixels
+		smooth	- linear filtering, otherwise nearest pixel
+	 Returns:
+		GLuint	- OpenGL texture name
+	*/
+	GLuint createTexture(int width, int height, bool smooth)
+	{
+		GLuint name;
+		GLint filter = smooth ? GL_LINEAR : GL_NEAREST;
+
+		glGenTextures(1, &name);
+		glBindTexture(GL_TEXTURE_2D, name);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+		return name;
+	}
+
+	/**
+	 Add a texture to the table, reusing a released slot if there is one
+	 Returns:
+		unsigned int	- Texture::id of the slot
+	*/
+	unsigned int addTextureSlot(const TextureSlot& slot)
+	{
+		size_t index = 0;
+		while (index < s_textures.size() && (s_textures[index].name != 0 || s_textures[index].loading))
+			index++;
+		if (index == s_textures.size())
+			s_textures.push_back({});
+
+		s_textures[index] = slot;
+		return (unsigned int)index + 1;
+	}
+
+	/**
+	 Look up the OpenGL texture of a Texture::id
+	 Returns:
+		const TextureSlot*	- null if the id has no loaded image
+	*/
+	const TextureSlot* findTexture(unsigned int id)
+	{
+		if (id == 0 || id > s_textures.size())
+			return nullptr;
+
+		const TextureSlot* slot = &s_textures[id - 1];
+		return slot->name ? slot : nullptr;
+	}
+
+	/**
+	 Delete the OpenGL texture of a loaded slot and free the slot for reuse
+	*/
+	void releaseTextureSlot(unsigned int id)
+	{
+		// a frame being drawn may still bind the name
+		waitForRenderThreads();
+		glDeleteTextures(1, &s_textures[id - 1].name);
+		s_textures[id - 1] = {};
+	}
+
+	/**
+	 Returns true if a Texture::id is reserved by an async load that has
+	 not finished
+	*/
+	bool textureLoading(unsigned int id)
+	{
+		return id != 0 && id <= s_textures.size() && s_textures[id - 1].loading;
+	}
+
+	/**
+	 Create a texture for a whole image.  The image sits one pixel in from
+	 the top left so texel 0,0 can be white for shapes, the rest of the
+	 border repeats the image edge.
+	 Parameters
+		pixels	- width * height * 4 bytes, rows top to bottom
+		width	- of the image in pixels
+		height	- of the image in pixels
+		smooth	- linear filtering, otherwise nearest pixel
+	 Returns:
+		TextureSlot	- the new texture, not yet in the table
+	*/
+	TextureSlot createImageTexture(const unsigned char* pixels, int width, int height, bool smooth)
+	{
+		const GLubyte white[] = { 0xFF, 0xFF, 0xFF, 0xFF };
+		GLuint name = createTexture(width + 1, height + 1, smooth);
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 1, 1, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 1, 0, width, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 1, 1, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		return { name, width + 1, height + 1, 1, 1, false, false, false };
+	}
+
+	/**
+	 Reserve a table slot for a texture that is still loading
+	 Returns:
+		unsigned int	- Texture::id of the slot
+	*/
+	unsigned int reserveTextureSlot()
+	{
+		TextureSlot slot = {};
+		slot.loading = true;
+		return addTextureSlot(slot);
+	}
+
+	/**
+	 Finish a reserved slot, releasing it if the load failed or the
+	 texture was freed while loading
+	 Parameters
+		id		- Texture::id from reserveTextureSlot
+		pixels	- decoded image, null if the load failed
+		width	- of the image in pixels
+		height	- of the image in pixels
+		smooth	- linear filtering, otherwise nearest pixel
+	*/
+	void fillTextureSlot(unsigned int id, const unsigned char* pixels, int width, int height, bool smooth)
+	{
+		TextureSlot& slot = s_textures[id - 1];
+		bool freed = slot.freed;
+
+		slot = {};
+		if (pixels && width > 0 && height > 0 && !freed)
+			slot = createImageTexture(pixels, width, height, smooth);
+	}
+
+	/**
+	 Upload an image into the bound texture and repeat its edge pixels
+	 outwards into the padding around it
+	 Parameters
+		pixels	- width * height * 4 bytes, rows top to bottom
+		x		- left of the image in the texture
+		y		- top of the image in the texture
+		width	- of the image in pixels
+		height	- of the image in pixels
+		padding	- pixels around the image to fill
+	*/
+	void uploadPadded(const unsigned char* pixels, int x, int y, int width, int height, int padding)
+	{
+		const unsigned char* lastRow = pixels + (size_t)(height - 1) * width * 4;
+		const unsigned char* lastColumn = pixels + (size_t)(width - 1) * 4;
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+		for (int i = 1; i <= padding; i++)
+		{
+			glTexSubImage2D(GL_TEXTURE_2D, 0, x, y - i, width, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, x, y + height - 1 + i, width, 1, GL_RGBA, GL_UNSIGNED_BYTE, lastRow);
+		}
+
+		// columns read one pixel from every row
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+		for (int i = 1; i <= padding; i++)
+		{
+			glTexSubImage2D(GL_TEXTURE_2D, 0, x - i, y, 1, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, x + width - 1 + i, y, 1, height, GL_RGBA, GL_UNSIGNED_BYTE, lastColumn);
+		}
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+
+	/**
+	 Start a new page for an atlas at the smallest page size, with the
+	 white texel for shapes packed into its top left corner
+	 Returns:
+		AtlasPage*	- the new page, last in the atlas page list
+	*/
+	AtlasPage* addAtlasPage(AtlasData& atlas)
+	{
+		const GLubyte white[] = { 0xFF, 0xFF, 0xFF, 0xFF };
+		int size = std::min(ATLAS_FIRST_PAGE_SIZE, atlas.pageSize);
+		GLuint name = createTexture(size, size, atlas.smooth);
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+
+		AtlasPage page;
+		page.texture = addTextureSlot({ name, size, size, 0, 0, false, false, true });
+		page.skyline.push_back({ 0, 0, size });
+
+		int x, y;
+		skylinePack(page.skyline, size, 1 + atlas.padding, 1 + atlas.padding, x, y);
+
+		atlas.pages.push_back(page);
+		return &atlas.pages.back();
+	}
+
+	/**
+	 Double the size of an atlas page, up to the atlas page size.  The
+	 OpenGL texture keeps its name and the packed images keep their texel
+	 positions, so textures already handed out stay valid.
+	*/
+	void growAtlasPage(AtlasData& atlas, AtlasPage& page)
+	{
+		TextureSlot& slot = s_textures[page.texture - 1];
+		int oldSize = slot.width;
+		int size = std::min(oldSize * 2, atlas.pageSize);
+
+		std::vector<unsigned char> pixels((size_t)oldSize * oldSize * 4);
+
+		glBindTexture(GL_TEXTURE_2D, slot.name);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+		// a frame being drawn samples the page at the size it was resolved with
+		waitForRenderThreads();
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, oldSize, oldSize, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		slot.width = slot.height = size;
+
+		// the new columns on the right are empty from the top down
+		page.skyline.push_back({ oldSize, 0, size - oldSize });
+	}
+
+	/**
+	 Find room for a rectangle on a square page using the skyline
+	 bottom-left heuristic: the lowest resulting edge wins, ties go to the
+	 narrowest span.  The skyline is updated when room is found.
+	 Parameters
+		skyline	- packed edge of the page, left to right
+		size	- width and height of the page
+		width	- of the rectangle
+		height	- of the rectangle
+		x		- receives the left of the rectangle
+		y		- receives the top of the rectangle
+	 Returns:
+		bool	- false if the rectangle does not fit
+	*/
+	bool skylinePack(std::vector<SkylineNode>& skyline, int size, int width, int height, int& x, int& y)
+	{
+		size_t best = skyline.size();
+		int bestBottom = 0;
+		int bestWidth = 0;
+
+		for (size_t i = 0; i < skyline.size(); i++)
+		{
+			int left = skyline[i].x;
+			if (left + width > size)
+				break;
+
+			// the rectangle rests on the highest node it spans
+			int top = 0;
+			int remaining = width;
+			for (size_t j = i; remaining > 0; j++)
+			{
+				top = std::max(top, skyline[j].y);
+				remaining -= skyline[j].width;
+			}
+
+			int bottom = top + height;
+			if (bottom > size)
+				continue;
+
+			if (best == skyline.size() || bottom < bestBottom
+				|| (bottom == bestBottom && skyline[i].width < bestWidth))
+			{
+				best = i;
+				bestBottom = bottom;
+				bestWidth = skyline[i].width;
+				x = left;
+				y = top;
+			}
+		}
+
+		if (best == skyline.size())
+			return false;
+
+		skyline.insert(skyline.begin() + best, { x, y + height, width });
+
+		// trim the nodes now covered by the rectangle
+		size_t next = best + 1;
+		while (next < skyline.size())
+		{
+			int overlap = x + width - skyline[next].x;
+			if (overlap <= 0)
+				break;
+
+			if (overlap >= skyline[next].width)
+			{
+				skyline.erase(skyline.begin() + next);
+			}
+			else
+			{
+				skyline[next].x += overlap;
+				skyline[next].width -= overlap;
+				break;
+			}
+		}
+
+		// join neighbours left at the same height
+		for (size_t i = 0; i + 1 < skyline.size(); )
+		{
+			if (skyline[i].y == skyline[i + 1].y)
+			{
+				skyline[i].width += skyline[i + 1].width;
+				skyline.erase(skyline.begin() + i + 1);
+			}
+			else
+			{
+				i++;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 Turn glyph bitmaps into a distance field texture, SDF_COLUMNS glyphs
+	 across.  Alpha is 0.5 on a glyph edge, rising inside and falling
+	 outside, so the alpha test of submitBatch cuts the edge out again
+	 wherever the quad is scaled or turned.  The draws are marked as
+	 distance fields so the test stays at 0.5 in every blend mode.
+	 Parameters
+		glyphs	- count glyphs of width * height bytes, 1 where a pixel is set
+	*/
+	SdfFont buildSdfFont(const std::vector<uint8_t>& glyphs, int glyphWidth, int glyphHeight, int count, int first)
+	{
+		int cellWidth = glyphWidth * SDF_RESOLUTION + 2 * SDF_SPREAD;
+		int cellHeight = glyphHeight * SDF_RESOLUTION + 2 * SDF_SPREAD;
+		int columns = std::min(count, SDF_COLUMNS);
+		int width = columns * cellWidth;
+		int height = (count + columns - 1) / columns * cellHeight;
+		std::vector<unsigned char> pixels(width * height * 4, 0xFF);
+
+		for (int glyph = 0; glyph < count; glyph++)
+		{
+			const uint8_t* bitmap = &glyphs[glyph * glyphWidth * glyphHeight];
+			int left = glyph % columns * cellWidth;
+			int top = glyph / columns * cellHeight;
+
+			for (int ty = 0; ty < cellHeight; ty++)
+			{
+				for (int tx = 0; tx < cellWidth; tx++)
+				{
+					// texel center in font pixels
+					float x = (tx - SDF_SPREAD + 0.5f) / SDF_RESOLUTION;
+					float y = (ty - SDF_SPREAD + 0.5f) / SDF_RESOLUTION;
+					float distance = glyphDistance(bitmap, glyphWidth, glyphHeight, x, y);
+					float alpha = 0.5f + distance * SDF_RESOLUTION / (2 * SDF_SPREAD);
+
+					alpha = std::min(std::max(alpha, 0.0f), 1.0f);
+					pixels[((top + ty) * width + left + tx) * 4 + 3] = (unsigned char)std::lround(alpha * 255);
+				}
+			}
+		}
+
+		SdfFont font;
+		font.texture = loadTexture(pixels.data(), width, height, true);
+		if (font.texture.id == 0)
+			return SdfFont();
+
+		font.glyphWidth = glyphWidth;
+		font.glyphHeight = glyphHeight;
+		font.first = first;
+		font.count = count;
+		font.columns = columns;
+		return font;
+	}
+
+	/**
+	 Signed distance from a point to the edge of a glyph, only looking as
+	 far as the spread of the field
+	 Parameters
+		glyph	- width * height bytes, 1 where a pixel is set
+		x, y	- point in font pixels, y down from the top
+	 Returns:
+		float	- positive inside the glyph, negative outside
+	*/
+	float glyphDistance(const uint8_t* glyph, int width, int height, float x, float y)
+	{
+		auto set = [glyph, width, height](int i, int j) {
+			return i >= 0 && i < width && j >= 0 && j < height && glyph[j * width + i];
+		};
+
+		int column = (int)std::floor(x);
+		int row = (int)std::floor(y);
+		bool inside = set(column, row);
+		float limit = (float)SDF_SPREAD / SDF_RESOLUTION;
+		int reach = (int)std::ceil(limit) + 1;
+		float nearest = limit;
+
+		// nearest pixel on the other side of the edge
+		for (int j = row - reach; j <= row + reach; j++)
+		{
+			for (int i = column - reach; i <= column + reach; i++)
+			{
+				if (set(i, j) == inside)
+					continue;
+
+				float dx = std::max(std::max(i - x, x - (i + 1)), 0.0f);
+				float dy = std::max(std::max(j - y, y - (j + 1)), 0.0f);
+				nearest = std::min(nearest, std::sqrt(dx * dx + dy * dy));
+			}
+		}
+
+		return inside ? nearest : -nearest;
+	}
+
+	/**
+	 Hand a load to the worker thread, starting it the first time
+	*/
+	void startLoad(std::unique_ptr<LoadJob> job)
+	{
+		if (!s_loader.worker.joinable())
+			s_loader.worker = std::thread(runLoader);
+
+		{
+			std::lock_guard<std::mutex> lock(s_loader.mutex);
+			s_loader.queued.push_back(std::move(job));
+		}
+		s_loader.wake.notify_one();
+		s_loader.pending++;
+	}
+
+	/**
+	 Worker thread, reads queued loads in order until the loader stops
+	*/
+	void runLoader()
+	{
+		std::unique_lock<std::mutex> lock(s_loader.mutex);
+
+		while (true)
+		{
+			s_loader.wake.wait(lock, [] { return s_loader.stopping || !s_loader.queued.empty(); });
+			if (s_loader.stopping)
+				return;
+
+			std::unique_ptr<LoadJob> job = std::move(s_loader.queued.front());
+			s_loader.queued.pop_front();
+
+			lock.unlock();
+			readLoad(*job);
+			lock.lock();
+
+			s_loader.done.push_back(std::move(job));
+		}
+	}
+
+	/**
+	 The slow part of a load, run on the worker thread.  Touches nothing
+	 shared with the main thread but the job.
+	*/
+	void readLoad(LoadJob& job)
+	{
+		switch (job.type)
+		{
+		case LoadImageFile:
+			if (!loadImage(job.filename, job.image))
+				job.image = Image();
+			break;
+
+		case LoadPackFile:
+			// read every page in now so uploads from the pack do not wait on the disk
+			if (job.file.open(job.filename))
+			{
+				const size_t PAGE_SIZE = 4096;
+				unsigned char sum = 0;
+				for (size_t offset = 0; offset < job.file.size(); offset += PAGE_SIZE)
+					sum += job.file.data()[offset];
+				volatile unsigned char sink = sum;
+				(void)sink;
+			}
+			break;
+
+		case LoadPackImage:
+			// the pixels are already decoded in the mapped pack
+			break;
+		}
+	}
+
+	/**
+	 Returns the number of bytes finishing a load will upload to OpenGL
+	*/
+	size_t uploadSize(const LoadJob& job)
+	{
+		Asset asset;
+
+		switch (job.type)
+		{
+		case LoadImageFile:
+			return job.image.pixels.size();
+
+		case LoadPackImage:
+			return findAsset(job.pack, job.name, asset) ? asset.size : 0;
+
+		default:
+			return 0;
+		}
+	}
+
+	/**
+	 Finish a load on the main thread, filling its reserved handle
+	*/
+	void finishLoad(LoadJob& job)
+	{
+		Asset asset;
+
+		switch (job.type)
+		{
+		case LoadImageFile:
+			fillTextureSlot(job.texture, job.image.pixels.data(), job.image.width, job.image.height, job.smooth);
+			break;
+
+		case LoadPackImage:
+			if (findAsset(job.pack, job.name, asset) && asset.type == PackImage)
+				fillTextureSlot(job.texture, asset.data, asset.width, asset.height, job.smooth);
+			else
+				fillTextureSlot(job.texture, nullptr, 0, 0, job.smooth);
+			break;
+
+		case LoadPackFile:
+			openPack(std::move(job.file), job.pack);
+			break;
+		}
+	}
+
+	/**
+	 Finish loads the worker has read, in the order they were started,
+	 until the next one would go over the upload budget.  At least one
+	 load finishes per paint so a large image cannot wait forever.
+	*/
+	void finishLoads()
+	{
+		if (s_loader.pending == 0)
+			return;
+
+		double start = glfwGetTime();
+		size_t uploaded = 0;
+		int finished = 0;
+
+		while (true)
+		{
+			LoadJob* next;
+			{
+				std::lock_guard<std::mutex> lock(s_loader.mutex);
+				if (s_loader.done.empty())
+					break;
+				next = s_loader.done.front().get();
+			}
+
+			// a pack image is searched after its pack, which is earlier in the queue
+			size_t size = uploadSize(*next);
+			if (finished > 0 && (uploaded + size > s_loader.budgetBytes
+				|| glfwGetTime() - start >= s_loader.budgetSeconds))
+				break;
+
+			std::unique_ptr<LoadJob> job;
+			{
+				std::lock_guard<std::mutex> lock(s_loader.mutex);
+				job = std::move(s_loader.done.front());
+				s_loader.done.pop_front();
+			}
+
+			finishLoad(*job);
+			uploaded += size;
+			finished++;
+			s_loader.pending--;
+		}
+	}
+
+	/**
+	 Write an integer in decimal
+	 Parameters:
+		buffer	- at least 21 characters
+		value	- number to write
+	 Returns:
+		size_t	- characters written
+	*/
+	size_t formatNumber(char* buffer, long long value)
+	{
+		char digits[24];
+		char* end = digits + sizeof(digits);
+
+		// negate unsigned so the lowest value does not overflow
+		unsigned long long magnitude = value < 0 ? 0ull - (unsigned long long)value : (unsigned long long)value;
+		char* start = formatDigits(end, magnitude, 10, false);
+		if (value < 0)
+			*--start = '-';
+
+		memcpy(buffer, start, end - start);
+		return end - start;
+	}
+
+	/**
+	 Write printf style formatted text, see drawFormatted for what is
+	 understood.  Does not allocate and does not depend on the locale.
+	 Parameters:
+		buffer	- receives the text, not null terminated
+		size	- of the buffer, longer text is cut off
+		format	- printf style format
+		args	- arguments for the format
+	 Returns:
+		size_t	- characters written
+	*/
+	size_t formatText(char* buffer, size_t size, const char* format, va_list args)
+	{
+		size_t length = 0;
+
+		for (const char* p = format; *p; p++)
+		{
+			if (*p != '%')
+			{
+				if (length < size)
+					buffer[length++] = *p;
+				continue;
+			}
+
+			// flags
+			bool left = false, zero = false, plus = false, space = false;
+			for (p++; ; p++)
+			{
+				if (*p == '-')
+					left = true;
+				else if (*p == '0')
+					zero = true;
+				else if (*p == '+')
+					plus = true;
+				else if (*p == ' ')
+					space = true;
+				else
+					break;
+			}
+
+			// width and precision
+			int width = 0;
+			if (*p == '*')
+			{
+				width = va_arg(args, int);
+				if (width < 0)
+				{
+					left = true;
+					width = -width;
+				}
+				p++;
+			}
+			else
+			{
+				while (*p >= '0' && *p <= '9')
+					width = width * 10 + *p++ - '0';
+			}
+
+			int precision = -1;
+			if (*p == '.')
+			{
+				precision = 0;
+				if (*++p == '*')
+				{
+					precision = va_arg(args, int);
+					p++;
+				}
+				else
+				{
+					while (*p >= '0' && *p <= '9')
+						precision = precision * 10 + *p++ - '0';
+				}
+			}
+
+			// argument size, 0 int, 1 long, 2 long long, 3 size_t
+			int argSize = 0;
+			while (*p == 'h')
+				p++;
+			while (*p == 'l')
+			{
+				argSize++;
+				p++;
+			}
+			if (*p == 'z')
+			{
+				argSize = 3;
+				p++;
+			}
+
+			if (*p == '\0')
+				break;
+
+			// digits are written backwards from the end of the buffer, large
+			// enough for any double in fixed point
+			char digits[352];
+			char* end = digits + sizeof(digits);
+			char* start = end;
+			const char* sign = "";
+			bool number = true;
+			bool integer = false;
+
+			switch (*p)
+			{
+			case 'd':
+			case 'i':
+			{
+				long long value = argSize == 2 ? va_arg(args, long long)
+					: argSize == 1 ? va_arg(args, long)
+					: argSize == 3 ? (long long)va_arg(args, ptrdiff_t)
+					: va_arg(args, int);
+				unsigned long long magnitude = value < 0 ? 0ull - (unsigned long long)value : (unsigned long long)value;
+
+				start = formatDigits(end, magnitude, 10, false);
+				sign = value < 0 ? "-" : plus ? "+" : space ? " " : "";
+				integer = true;
+				break;
+			}
+			case 'u':
+			case 'x':
+			case 'X':
+			{
+				unsigned long long value = argSize == 2 ? va_arg(args, unsigned long long)
+					: argSize == 1 ? va_arg(args, unsigned long)
+					: argSize == 3 ? va_arg(args, size_t)
+					: va_arg(args, unsigned int);
+
+				start = formatDigits(end, value, *p == 'u' ? 10 : 16, *p == 'X');
+				integer = true;
+				break;
+			}
+			case 'f':
+			case 'F':
+			{
+				double value = va_arg(args, double);
+
+				start = formatFixed(end, value, precision < 0 ? 6 : std::min(precision, 17));
+				sign = std::signbit(value) ? "-" : plus ? "+" : space ? " " : "";
+				number = std::isfinite(value);
+				break;
+			}
+			case 'c':
+				*--start = (char)va_arg(args, int);
+				number = false;
+				break;
+			case 's':
+			{
+				const char* text = va_arg(args, const char*);
+				if (!text)
+					text = "(null)";
+
+				// copy into the buffer as far as it fits
+				size_t textLength = strlen(text);
+				if (precision >= 0 && (size_t)precision < textLength)
+					textLength = precision;
+				textLength = std::min(textLength, sizeof(digits));
+
+				start = end - textLength;
+				memcpy(start, text, textLength);
+				number = false;
+				break;
+			}
+			default:
+				// %% and anything not understood are written as they are
+				if (*p != '%' && length < size)
+					buffer[length++] = '%';
+				*--start = *p;
+				number = false;
+				width = 0;
+				break;
+			}
+
+			// the precision of an integer is its least number of digits, so
+			// 0 has none at precision 0, and the 0 flag is left out
+			if (integer && precision >= 0)
+			{
+				if (precision == 0 && end - start == 1 && *start == '0')
+					start = end;
+				while (end - start < std::min(precision, (int)sizeof(digits)))
+					*--start = '0';
+				zero = false;
+			}
+
+			// pad to the width, zeros go between the sign and the digits
+			size_t signLength = strlen(sign);
+			size_t fieldLength = signLength + (end - start);
+			size_t padding = (size_t)width > fieldLength ? width - fieldLength : 0;
+			char pad = zero && number && !left ? '0' : ' ';
+
+			if (pad == ' ' && !left)
+			{
+				for (; padding > 0 && length < size; padding--)
+					buffer[length++] = ' ';
+			}
+			for (size_t i = 0; i < signLength && length < size; i++)
+				buffer[length++] = sign[i];
+			if (pad == '0')
+			{
+				for (; padding > 0 && length < size; padding--)
+					buffer[length++] = '0';
+			}
+			for (const char* c = start; c < end && length < size; c++)
+				buffer[length++] = *c;
+			for (; padding > 0 && length < size; padding--)
+				buffer[length++] = ' ';
+		}
+
+		return length;
+	}
+
+	/**
+	 Write an unsigned integer backwards, ending before end
+	 Parameters:
+		end		- one past the last digit
+		value	- number to write
+		base	- 10 or 16
+		upper	- use upper case hex digits
+	 Returns:
+		char*	- first digit
+	*/
+	char* formatDigits(char* end, unsigned long long value, unsigned int base, bool upper)
+	{
+		const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+
+		do
+		{
+			*--end = digits[value % base];
+			value /= base;
+		} while (value != 0);
+
+		return end;
+	}
+
+	/**
+	 Write the magnitude of a double in fixed point backwards, ending
+	 before end, the sign is left to the caller
+	 Parameters:
+		end			- one past the last digit, with room for 309 digits,
+					  the point and the decimals before it
+		value		- number to write
+		decimals	- digits after the point, 0 to 17
+	 Returns:
+		char*	- first character
+	*/
+	char* formatFixed(char* end, double value, int decimals)
+	{
+		if (std::isnan(value))
+			return (char*)memcpy(end - 3, "nan", 3);
+		if (std::isinf(value))
+			return (char*)memcpy(end - 3, "inf", 3);
+
+		double magnitude = std::fabs(value);
+		double scale = std::pow(10.0, decimals);	// exact up to 10^22
+		double product = magnitude * scale;
+
+		if (product < 1e19)
+		{
+			// the exact product is product + error, round it to the nearest
+			// integer with ties to even like printf
+			double error = std::fma(magnitude, scale, -product);
+			double whole = std::floor(product);
+			double fraction = product - whole;
+			unsigned long long digits = (unsigned long long)whole;
+
+			// past 2^53 the product has no fraction and the error holds whole units
+			if (fraction == 0 && std::fabs(error) >= 0.5)
+				digits += (long long)std::round(error);
+			else if (fraction > 0.5 || (fraction == 0.5 && (error > 0 || (error == 0 && (digits & 1)))))
+				digits++;
+
+			for (int i = 0; i < decimals; i++)
+			{
+				*--end = (char)('0' + digits % 10);
+				digits /= 10;
+			}
+			if (decimals > 0)
+				*--end = '.';
+
+			return formatDigits(end, digits, 10, false);
+		}
+
+		// a double holds 17 significant digits, the places after them are 0
+		int exponent = (int)std::floor(std::log10(magnitude));
+		int shift = exponent - 16;
+		unsigned long long digits = (unsigned long long)std::round(magnitude / std::pow(10.0, shift));
+
+		for (int i = 0; i < (shift >= 0 ? decimals : decimals + shift); i++)
+			*--end = '0';
+		for (int i = 0; i < -shift; i++)
+		{
+			*--end = (char)('0' + digits % 10);
+			digits /= 10;
+		}
+		if (decimals > 0)
+			*--end = '.';
+		for (int i = 0; i < shift; i++)
+			*--end = '0';
+
+		return formatDigits(end, digits, 10, false);
+	}
+
+	/**
+	 Characters of a given size that fit across a width, at least one
+	 Returns:
+		int	- characters per line, 0 for no wrapping when width is 0
+	*/
+	int wrapColumns(float width, int size)
+	{
+		if (width <= 0)
+			return 0;
+
+		float columns = std::floor(width / (8 * size));
+		return columns < 1 ? 1 : columns > INT32_MAX / 2 ? INT32_MAX / 2 : (int)columns;
+	}
+
+	/**
+	 Find the layout of text in the cache, laying it out if it is not
+	 there.  The caller holds the cache mutex while it uses the layout.
+	 Parameters:
+		columns	- characters per line, see wrapColumns
+	*/
+	const TextLayout& findLayout(std::string_view text, int columns)
+	{
+		LayoutCache& cache = s_layouts;
+
+		// FNV-1a, mixed with the columns so wrapping the text again
+		// lands in another slot
+		uint64_t hash = 0xCBF29CE484222325ull;
+		for (char c : text)
+			hash = (hash ^ (unsigned char)c) * 0x100000001B3ull;
+		hash ^= (uint64_t)columns * 0x9E3779B97F4A7C15ull;
+
+		if (cache.table.empty())
+		{
+			cache.layouts.reserve(LAYOUT_CACHE_SIZE);
+			cache.table.assign(LAYOUT_TABLE_SIZE, -1);
+		}
+
+		size_t mask = LAYOUT_TABLE_SIZE - 1;
+		for (size_t slot = hash & mask; cache.table[slot] >= 0; slot = (slot + 1) & mask)
+		{
+			int index = cache.table[slot];
+			TextLayout& layout = cache.layouts[index];
+			if (layout.hash == hash && layout.wrapColumns == columns && layout.text == text)
+			{
+				if (cache.head != index)
+				{
+					unlinkLayout(cache, index);
+					linkLayout(cache, index);
+				}
+				return layout;
+			}
+		}
+
+		// not found, take a new layout or the least recently used one
+		int index;
+		if (cache.layouts.size() < LAYOUT_CACHE_SIZE)
+		{
+			index = (int)cache.layouts.size();
+			cache.layouts.emplace_back();
+		}
+		else
+		{
+			index = cache.tail;
+			evictLayout(cache, index);
+		}
+
+		size_t slot = hash & mask;
+		while (cache.table[slot] >= 0)
+			slot = (slot + 1) & mask;
+		cache.table[slot] = index;
+		linkLayout(cache, index);
+
+		TextLayout& layout = cache.layouts[index];
+		layout.hash = hash;
+		layout.wrapColumns = columns;
+		layout.text.assign(text.data(), text.size());
+		splitLines(layout);
+
+		return layout;
+	}
+
+	/**
+	 Split the text of a layout into lines at each \n and, when it wraps,
+	 before the word that would cross its columns.  A word longer than a
+	 line is split.  The space a line is wrapped at is dropped.
+	*/
+	void splitLines(TextLayout& layout)
+	{
+		const std::string& text = layout.text;
+		uint32_t columns = (uint32_t)layout.wrapColumns;
+
+		layout.lines.clear();
+		layout.widest = 0;
+
+		// a final \n ends the last line rather than starting another
+		for (uint32_t start = 0; start < text.size(); )
+		{
+			size_t newline = text.find('\n', start);
+			uint32_t end = newline == std::string::npos ? (uint32_t)text.size() : (uint32_t)newline;
+
+			for (uint32_t line = start; ; )
+			{
+				uint32_t length = end - line;
+				if (columns == 0 || length <= columns)
+				{
+					layout.lines.push_back({ line, length });
+					layout.widest = std::max(layout.widest, length);
+					break;
+				}
+
+				// break at the last space that keeps the line inside
+				uint32_t space = line + columns;
+				while (space > line && text[space] != ' ')
+					space--;
+
+				if (space > line)
+				{
+					layout.lines.push_back({ line, space - line });
+					layout.widest = std::max(layout.widest, space - line);
+					line = space + 1;
+					if (line == end)
+						break;
+				}
+				else
+				{
+					layout.lines.push_back({ line, columns });
+					layout.widest = std::max(layout.widest, columns);
+					line += columns;
+				}
+			}
+
+			start = end + 1;
+		}
+	}
+
+	/**
+	 Remove a layout from the table and the recently used list so it
+	 can be reused
+	*/
+	void evictLayout(LayoutCache& cache, int index)
+	{
+		size_t mask = LAYOUT_TABLE_SIZE - 1;
+		size_t hole = cache.layouts[index].hash & mask;
+		while (cache.table[hole] != index)
+			hole = (hole + 1) & mask;
+
+		// shift back the entries after the hole that may now sit closer
+		// to their own slot, so probes never stop early at the hole
+		for (size_t slot = (hole + 1) & mask; cache.table[slot] >= 0; slot = (slot + 1) & mask)
+		{
+			size_t home = cache.layouts[cache.table[slot]].hash & mask;
+			if (((slot - home) & mask) >= ((slot - hole) & mask))
+			{
+				cache.table[hole] = cache.table[slot];
+				hole = slot;
+			}
+		}
+		cache.table[hole] = -1;
+
+		unlinkLayout(cache, index);
+	}
+
+	/**
+	 Put a layout at the head of the recently used list
+	*/
+	void linkLayout(LayoutCache& cache, int index)
+	{
+		TextLayout& layout = cache.layouts[index];
+
+		layout.prev = -1;
+		layout.next = cache.head;
+		if (cache.head >= 0)
+			cache.layouts[cache.head].prev = index;
+		else
+			cache.tail = index;
+		cache.head = index;
+	}
+
+	/**
+	 Take a layout out of the recently used list
+	*/
+	void unlinkLayout(LayoutCache& cache, int index)
+	{
+		TextLayout& layout = cache.layouts[index];
+
+		if (layout.prev >= 0)
+			cache.layouts[layout.prev].next = layout.next;
+		else
+			cache.head = layout.next;
+		if (layout.next >= 0)
+			cache.layouts[layout.next].prev = layout.prev;
+		else
+			cache.tail = layout.prev;
+		layout.prev = -1;
+		layout.next = -1;
+	}
+
+	/**
+	 Find the triangles of a polygon in the cache, triangulating it if it
+	 is not there.  The caller holds the cache mutex while it uses them.
+	*/
+	const Tessellation& findTessellation(const Point* points, int count)
+	{
+		TessellationCache& cache = s_tessellations;
+
+		// FNV-1a of the coordinates as they are stored
+		uint64_t hash = 0xCBF29CE484222325ull;
+		const unsigned char* bytes = (const unsigned char*)points;
+		for (size_t i = 0; i < count * sizeof(Point); i++)
+			hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+
+		if (cache.slots.empty())
+			cache.slots.resize(TESSELLATION_CACHE_SIZE);
+
+		Tessellation& tessellation = cache.slots[hash & (TESSELLATION_CACHE_SIZE - 1)];
+		if (tessellation.hash == hash && tessellation.points.size() == (size_t)count
+			&& memcmp(tessellation.points.data(), points, count * sizeof(Point)) == 0)
+			return tessellation;
+
+		tessellation.hash = hash;
+		tessellation.points.assign(points, points + count);
+		triangulate(points, count, cache.remaining, tessellation.triangles);
+		return tessellation;
+	}
+
+	/**
+	 Split a polygon into triangles by ear clipping: repeatedly cut off a
+	 convex corner whose triangle holds no other corner, until three are
+	 left.  Takes up to count squared steps, which the cache pays once.
+	 Parameters
+		remaining	- scratch list of corners
+		triangles	- receives three indices into points for each triangle
+	*/
+	void triangulate(const Point* points, int count, std::vector<GLuint>& remaining, std::vector<GLuint>& triangles)
+	{
+		triangles.clear();
+		remaining.clear();
+		for (int i = 0; i < count; i++)
+		{
+			if (remaining.empty() || !samePoint(points[i], points[remaining.back()]))
+				remaining.push_back((GLuint)i);
+		}
+		while (remaining.size() > 1 && samePoint(points[remaining.back()], points[remaining.front()]))
+			remaining.pop_back();
+
+		if (remaining.size() < 3)
+			return;
+
+		// clip counter-clockwise, so convex corners turn left
+		double area = 0;
+		for (size_t i = 0, j = remaining.size() - 1; i < remaining.size(); j = i++)
+		{
+			const Point& a = points[remaining[j]];
+			const Point& b = points[remaining[i]];
+			area += (double)a.x * b.y - (double)b.x * a.y;
+		}
+		if (area == 0)
+			return;
+		if (area < 0)
+			std::reverse(remaining.begin(), remaining.end());
+
+		size_t corner = 0;
+		size_t misses = 0;
+		while (remaining.size() > 3)
+		{
+			size_t size = remaining.size();
+			GLuint a = remaining[(corner + size - 1) % size];
+			GLuint b = remaining[corner];
+			GLuint c = remaining[(corner + 1) % size];
+			float direction = turn(points[a], points[b], points[c]);
+
+			// straight corners go without a triangle, and when edges cross
+			// so that no ear is left the next corner is cut off anyway
+			if (direction == 0 || misses >= size
+				|| (direction > 0 && !earHasCorner(points, remaining, a, b, c)))
+			{
+				if (direction != 0)
+					triangles.insert(triangles.end(), { a, b, c });
+				remaining.erase(remaining.begin() + corner);
+				// the corner before may have become an ear
+				corner = corner == 0 ? remaining.size() - 1 : corner - 1;
+				misses = 0;
+			}
+			else
+			{
+				corner = (corner + 1) % size;
+				misses++;
+			}
+		}
+
+		if (turn(points[remaining[0]], points[remaining[1]], points[remaining[2]]) != 0)
+			triangles.insert(triangles.end(), { remaining[0], remaining[1], remaining[2] });
+	}
+
+	/**
+	 Check whether a corner of the polygon lies in the triangle a, b, c,
+	 which stops the triangle from being cut off.  Corners on the polygon
+	 edges a-b and b-c count, corners on the new diagonal c-a do not, and
+	 neither do repeats of a, b or c themselves.
+	*/
+	bool earHasCorner(const Point* points, const std::vector<GLuint>& remaining, GLuint a, GLuint b, GLuint c)
+	{
+		for (GLuint index : remaining)
+		{
+			if (index == a || index == b || index == c)
+				continue;
+
+			Point p = points[index];
+			if (samePoint(p, points[a]) || samePoint(p, points[b]) || samePoint(p, points[c]))
+				continue;
+
+			if (turn(points[a], points[b], p) >= 0 && turn(points[b], points[c], p) >= 0
+				&& turn(points[c], points[a], p) > 0)
+				return true;
+		}
+		return false;
+	}
+
+	/**
+	 Returns twice the signed area of the triangle a, b, c: positive when
+	 c is left of the line from a to b, 0 when they are in line
+	*/
+	float turn(Point a, Point b, Point c)
+	{
+		return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	}
+
+	/**
+	 Returns true when a and b are at exactly the same position
+	*/
+	bool samePoint(Point a, Point b)
+	{
+		return a.x == b.x && a.y == b.y;
+	}
+
+	/**
+	 Destroy the window of a context, leaving its buffers for reuse
+	*/
+	void closeContext(ContextData& context)
+	{
+		if (context.render)
+			stopRenderThread(context);
+
+		glfwMakeContextCurrent(context.window);
+		glDeleteTextures(1, &context.whiteTexture);
+		destroyOffscreen(context);
+		glfwMakeContextCurrent(NULL);
+		glfwDestroyWindow(context.window);
+
+		context.window = nullptr;
+		context.whiteTexture = 0;
+		context.viewportChanged = false;
+		context.cache = StateCache();
+		s_contexts.erase(std::find(s_contexts.begin(), s_contexts.end(), &context));
+
+		// texture calls need a current context, any open one shares the textures
+		if (!s_contexts.empty())
+			glfwMakeContextCurrent(mainThreadWindow(*s_contexts.front()));
+	}
+
+	/**
+	 Create the framebuffer a headless context draws into and the frame
+	 texture paint resolves it into.  Leaves the framebuffer bound, the
+	 binding belongs to the context so it stays for every frame.
+	 Parameters
+		samples	- per pixel, clamped to what the driver supports
+		depth	- give the framebuffer a depth buffer
+	 Returns:
+		bool	- false if the driver cannot draw into the framebuffer
+	*/
+	bool createOffscreen(ContextData& context, int width, int height, int samples, bool depth)
+	{
+		GLint maxSamples = 0;
+		glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+		samples = std::min(samples, (int)maxSamples);
+
+		glGenRenderbuffers(2, context.renderbuffers);
+		glGenFramebuffers(1, &context.framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, context.framebuffer);
+
+		glBindRenderbuffer(GL_RENDERBUFFER, context.renderbuffers[0]);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, context.renderbuffers[0]);
+		if (depth)
+		{
+			glBindRenderbuffer(GL_RENDERBUFFER, context.renderbuffers[1]);
+			glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, context.renderbuffers[1]);
+		}
+		bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+		context.frameTexture = createTexture(width, height, false);
+		glGenFramebuffers(1, &context.resolveFramebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, context.resolveFramebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, context.frameTexture, 0);
+		complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+		glBindFramebuffer(GL_FRAMEBUFFER, context.framebuffer);
+		context.frameWidth = width;
+		context.frameHeight = height;
+
+		return complete;
+	}
+
+	/**
+	 Delete the framebuffers of a headless context, its window's context
+	 must be current
+	*/
+	void destroyOffscreen(ContextData& context)
+	{
+		if (!context.framebuffer)
+			return;
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &context.framebuffer);
+		glDeleteFramebuffers(1, &context.resolveFramebuffer);
+		glDeleteRenderbuffers(2, context.renderbuffers);
+		glDeleteTextures(1, &context.frameTexture);
+
+		context.framebuffer = 0;
+		context.renderbuffers[0] = context.renderbuffers[1] = 0;
+		context.resolveFramebuffer = 0;
+		context.frameTexture = 0;
+	}
+
+	/**
+	 Show a drawn frame and clear for the next one.  A window swaps its
+	 buffers, a headless context resolves its samples into the frame
+	 texture.
+	*/
+	void presentFrame(ContextData& context, const FrameBatch& batch)
+	{
+		if (context.framebuffer)
+		{
+			int width = context.frameWidth;
+			int height = context.frameHeight;
+
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, context.framebuffer);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, context.resolveFramebuffer);
+			glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			glBindFramebuffer(GL_FRAMEBUFFER, context.framebuffer);
+
+			// readFrame may read the texture through another context
+			glFlush();
+		}
+		else
+			glfwSwapBuffers(context.window);
+
+		glClear(clearMask(batch));
+	}
+
+	/**
+	 Hand a context's window over to a new render thread.  The main thread
+	 keeps a hidden window sharing its textures so loading still works.
+	*/
+	void startRenderThread(ContextData& context)
+	{
+		RenderThread* render = new RenderThread;
+		context.render.reset(render);
+		render->batch.depthBuffer = context.batch.depthBuffer;
+
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		render->uploadWindow = glfwCreateWindow(1, 1, "", NULL, context.window);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+		// a context can only be current on one thread
+		glfwMakeContextCurrent(render->uploadWindow);
+		render->thread = std::thread(runRenderThread, &context);
+	}
+
+	/**
+	 Let the render thread draw the frame it has, then end it and take the
+	 window back
+	*/
+	void stopRenderThread(ContextData& context)
+	{
+		RenderThread& render = *context.render;
+
+		{
+			std::lock_guard<std::mutex> lock(render.mutex);
+			render.stopping = true;
+		}
+		render.wake.notify_one();
+		render.thread.join();
+
+		if (glfwGetCurrentContext() == render.uploadWindow)
+			glfwMakeContextCurrent(NULL);
+		if (render.uploadWindow)
+			glfwDestroyWindow(render.uploadWindow);
+
+		context.render.reset();
+	}
+
+	/**
+	 Render thread, draws and swaps each frame handed over by paint
+	*/
+	void runRenderThread(ContextData* context)
+	{
+		RenderThread& render = *context->render;
+		glfwMakeContextCurrent(context->window);
+
+		std::unique_lock<std::mutex> lock(render.mutex);
+		while (true)
+		{
+			render.wake.wait(lock, [&render] { return render.frameReady || render.stopping; });
+			if (!render.frameReady)
+				break;
+
+			if (render.viewportChanged)
+			{
+				glViewport(0, 0, render.viewportWidth, render.viewportHeight);
+				render.viewportChanged = false;
+			}
+
+			// paint waits for frameReady to clear before touching the batch
+			lock.unlock();
+			submitBatch(*context, render.batch);
+			presentFrame(*context, render.batch);
+			lock.lock();
+
+			render.frameReady = false;
+			render.idle.notify_one();
+		}
+
+		glfwMakeContextCurrent(NULL);
+	}
+
+	/**
+	 Give the recorded frame to the render thread and take back the
+	 buffers of the frame it drew last, waiting if it is still drawing.
+	 Both frames keep their buffers so handing over never allocates.
+	*/
+	void handOffFrame(ContextData& context)
+	{
+		RenderThread& render = *context.render;
+		FrameBatch& batch = context.batch;
+
+		// textures uploaded on this thread must reach the render thread's context
+		glFlush();
+
+		{
+			std::unique_lock<std::mutex> lock(render.mutex);
+			render.idle.wait(lock, [&render] { return !render.frameReady; });
+
+			batch.vertices.swap(render.batch.vertices);
+			batch.indices.swap(render.batch.indices);
+			batch.commands.swap(render.batch.commands);
+			batch.states.swap(render.batch.states);
+			std::swap(batch.sharedStates, render.batch.sharedStates);
+			std::swap(batch.stats, render.batch.stats);
+
+			if (context.viewportChanged)
+			{
+				render.viewportWidth = context.viewportWidth;
+				render.viewportHeight = context.viewportHeight;
+				render.viewportChanged = true;
+				context.viewportChanged = false;
+			}
+
+			render.frameReady = true;
+		}
+		render.wake.notify_one();
+	}
+
+	/**
+	 Wait until the render thread of a context has drawn the frame it was
+	 handed
+	*/
+	void waitForFrame(ContextData& context)
+	{
+		RenderThread& render = *context.render;
+
+		std::unique_lock<std::mutex> lock(render.mutex);
+		render.idle.wait(lock, [&render] { return !render.frameReady; });
+	}
+
+	/**
+	 Wait until no render thread is drawing, before a texture their frames
+	 may use is deleted or given new storage.  Frames handed over later
+	 resolve their textures again, so they see the change.
+	*/
+	void waitForRenderThreads()
+	{
+		for (ContextData* context : s_contexts)
+		{
+			if (context->render)
+				waitForFrame(*context);
+		}
+	}
+
+	/**
+	 Returns the window whose OpenGL context the main thread may make
+	 current for a context
+	*/
+	GLFWwindow* mainThreadWindow(const ContextData& context)
+	{
+		return context.render ? context.render->uploadWindow : context.window;
+	}
+
+	/**
+	 Record a filled rectangle into a frame batch, see drawQuad
+	*/
+	void batchQuad(FrameBatch& batch, float x, float y, float width, float height, unsigned int color)
+	{
+		AllocationScope scope;
+
+		size_t first = batch.indices.size();
+
+		addQuad(batch, x, y, width, height, packColor(color));
+
+		addCommand(batch, { PrimitiveFilled, 0, false, 0, BlendOpaque, false, {} }, first);
+	}
+
+	/**
+	 Record a rectangle shaded between its corners into a frame batch, see
+	 drawQuad.  Two triangles would blend each color along only one
+	 diagonal, so a middle vertex with the average color makes it a fan of
+	 four.
+	*/
+	void batchGradientQuad(FrameBatch& batch, float x, float y, float width, float height, unsigned int bottomLeft,
+		unsigned int bottomRight, unsigned int topRight, unsigned int topLeft)
+	{
+		AllocationScope scope;
+
+		size_t first = batch.indices.size();
+		PackedColor corners[4] = { packColor(bottomLeft), packColor(bottomRight), packColor(topRight), packColor(topLeft) };
+
+		PackedColor middle;
+		middle.red = (GLubyte)((corners[0].red + corners[1].red + corners[2].red + corners[3].red + 2) / 4);
+		middle.green = (GLubyte)((corners[0].green + corners[1].green + corners[2].green + corners[3].green + 2) / 4);
+		middle.blue = (GLubyte)((corners[0].blue + corners[1].blue + corners[2].blue + corners[3].blue + 2) / 4);
+		middle.alpha = (GLubyte)((corners[0].alpha + corners[1].alpha + corners[2].alpha + corners[3].alpha + 2) / 4);
+
+		GLuint center = addVertex(batch, x + width / 2, y + height / 2, middle);
+		addVertex(batch, x, y, corners[0]);
+		addVertex(batch, x + width, y, corners[1]);
+		addVertex(batch, x + width, y + height, corners[2]);
+		addVertex(batch, x, y + height, corners[3]);
+
+		for (GLuint i = 1; i <= 4; i++)
+		{
+			batch.indices.push_back(center);
+			batch.indices.push_back(center + i);
+			batch.indices.push_back(center + i % 4 + 1);
+		}
+
+		addCommand(batch, { PrimitiveFilled, 0, false, 0, BlendOpaque, false, {} }, first);
+	}
+
+	/**
+	 Record a point into a frame batch, see drawPoint
+	*/
+	void batchPoint(FrameBatch& batch, float x, float y, float size, unsigned int color, bool smooth)
+	{
+		AllocationScope scope;
+
+		size_t first = batch.indices.size();
+
+		batch.indices.push_back(addVertex(batch, x, y, packColor(color)));
+
+		addCommand(batch, { PrimitivePoints, size, smooth, 0, BlendOpaque, false, {} }, first);
+	}
+
+	/**
+	 Record a line into a frame batch, see drawLine
+	*/
+	void batchLine(FrameBatch& batch, float x1, float y1, float x2, float y2, float width, unsigned int color, bool smooth)
+	{
+		AllocationScope scope;
+
+		// glLineWidth is capped at 1 by many drivers, wider lines are triangles
+		if (width > 1)
+		{
+			Point points[2] = { { x1, y1 }, { x2, y2 } };
+			batchPolyline(batch, points, 2, width, color, JoinMiter, CapButt, false);
+			return;
+		}
+
+		size_t first = batch.indices.size();
+		PackedColor packed = packColor(color);
+
+		batch.indices.push_back(addVertex(batch, x1, y1, packed));
+		batch.indices.push_back(addVertex(batch, x2, y2, packed));
+
+		addCommand(batch, { PrimitiveLines, width, smooth, 0, BlendOpaque, false, {} }, first);
+	}
+
+	/**
+	 Record a line of segments into a frame batch as filled triangles, see
+	 drawPolyline.  Each segment is a quad and each corner fills the gap
+	 on its outer side, the quads overlap on the inner side.  A segment is
+	 added once the next one is known, so the last can get its cap.
+	*/
+	void batchPolyline(FrameBatch& batch, const Point* points, int count, float width, unsigned int color, int join,
+		int cap, bool closed)
+	{
+		AllocationScope scope;
+
+		if (count < 2 || !(width > 0))
+			return;
+
+		size_t first = batch.indices.size();
+		PackedColor packed = packColor(color);
+		float half = width / 2;
+
+		bool started = false;
+		Point firstDirection = {};
+		Point start = {}, end = {}, direction = {};	// segment waiting to be added
+		int segments = closed ? count : count - 1;
+
+		for (int i = 0; i < segments; i++)
+		{
+			Point from = points[i];
+			Point to = points[(i + 1) % count];
+			float dx = to.x - from.x;
+			float dy = to.y - from.y;
+			float length = sqrt(dx * dx + dy * dy);
+
+			// repeated points have no direction to draw
+			if (!(length > 0))
+				continue;
+
+			Point next = { dx / length, dy / length };
+			if (started)
+			{
+				addSegment(batch, start, end, direction, half, packed);
+				addJoin(batch, from, direction, next, half, join, packed);
+			}
+			else
+			{
+				started = true;
+				firstDirection = next;
+				if (!closed && cap == CapSquare)
+					from = { from.x - next.x * half, from.y - next.y * half };
+				else if (!closed && cap == CapRound)
+					addArc(batch, from, { -next.y * half, next.x * half }, (float)M_PI, half, packed);
+			}
+
+			start = from;
+			end = to;
+			direction = next;
+		}
+
+		if (!started)
+			return;
+
+		if (closed)
+			addJoin(batch, points[0], direction, firstDirection, half, join, packed);
+		else if (cap == CapSquare)
+			end = { end.x + direction.x * half, end.y + direction.y * half };
+		else if (cap == CapRound)
+			addArc(batch, end, { direction.y * half, -direction.x * half }, (float)M_PI, half, packed);
+
+		addSegment(batch, start, end, direction, half, packed);
+
+		addCommand(batch, { PrimitiveFilled, 0, false, 0, BlendOpaque, false, {} }, first);
+	}
+
+	/**
+	 Record a filled polygon into a frame batch, see drawPolygon.  Every
+	 point becomes a vertex and the cached triangles index them.
+	*/
+	void batchPolygon(FrameBatch& batch, const Point* points, int count, unsigned int color)
+	{
+		AllocationScope scope;
+
+		if (count < 3)
+			return;
+
+		size_t first = batch.indices.size();
+		PackedColor packed = packColor(color);
+
+		GLuint base = (GLuint)batch.vertices.size();
+		for (int i = 0; i < count; i++)
+			addVertex(batch, points[i].x, points[i].y, packed);
+
+		{
+			std::lock_guard<std::mutex> lock(s_tessellations.mutex);
+			const Tessellation& tessellation = findTessellation(points, count);
+			for (GLuint index : tessellation.triangles)
+				batch.indices.push_back(base + index);
+		}
+
+		addCommand(batch, { PrimitiveFilled, 0, false, 0, BlendOpaque, false, {} }, first);
+	}
+
+	/**
+	 Record a filled circle into a frame batch, see drawCircle and
+	 drawGradientCircle
+	*/
+	void batchCircle(FrameBatch& batch, float x, float y, float radius, unsigned int centerColor,
+		unsigned int edgeColor, int sides)
+	{
+		AllocationScope scope;
+
+		if (sides < 3)
+			return;
+
+		size_t first = batch.indices.size();
+		PackedColor packed = packColor(edgeColor);
+
+		GLuint center = addVertex(batch, x, y, packColor(centerColor));
+
+		// rotate a unit vector around the circle instead of calling
+		// cos and sin for every side
+		GLfloat angle = (GLfloat)(2.0 * M_PI / sides);
+		GLfloat stepCos = cos(angle);
+		GLfloat stepSin = sin(angle);
+		GLfloat dx = stepCos;
+		GLfloat dy = stepSin;
+
+		for (int i = 0; i < sides; i++)
+		{
+			addVertex(batch, x + radius * dx, y + radius * dy, packed);
+
+			GLfloat next = dx * stepCos - dy * stepSin;
+			dy = dx * stepSin + dy * stepCos;
+			dx = next;
+		}
+
+		// triangle fan as indexed triangles, last side wraps to the first
+		for (GLuint i = 1; i <= (GLuint)sides; i++)
+		{
+			batch.indices.push_back(center);
+			batch.indices.push_back(center + i);
+			batch.indices.push_back(center + (i % sides) + 1);
+		}
+
+		addCommand(batch, { PrimitiveFilled, 0, false, 0, BlendOpaque, false, {} }, first);
+	}
+
+	/**
+	 Call run for every horizontal run of lit pixels of 8x8 text, shared
+	 by drawText, drawTextBox and TextBlock.  Rows are size pixels tall,
+	 the top one from y + 8 up.
+	 Parameters:
+		run	- called with the x, y, width and height of each run
+	*/
+	template <typename Run>
+	void textRuns(float x, float y, std::string_view text, int size, Run run)
+	{
+		for (size_t c = 0; c < text.size(); c++)
+		{
+			unsigned int glyph = (unsigned char)text[c] - 32u;
+			if (glyph >= (unsigned int)CHARACTER_COUNT)
+				glyph = FALLBACK_CHARACTER;
+
+			GLfloat ypos = y + 8;
+			for (int i = 0; i < 8; i++)
+			{
+				for (int r = 0; r < GLYPH_RUNS.count[glyph][i]; r++)
+				{
+					uint8_t span = GLYPH_RUNS.runs[glyph][i][r];
+					run(x + (span >> 4) * size, ypos, (GLfloat)((span & 0x0F) * size), (GLfloat)size);
+				}
+				ypos -= size;
+			}
+			x += 8 * size;
+		}
+	}
+
+	/**
+	 Call run for every horizontal run of set pixels of UTF-8 text in a
+	 bitmap font, found as the rows are read.  Cells are placed like the
+	 8x8 characters, the top row height pixels above y.
+	*/
+	template <typename Run>
+	void fontRuns(float x, float y, std::string_view text, const BitmapFont& font, int size, Run run)
+	{
+		size_t glyphSize = (size_t)font.height * font.rowBytes;
+
+		for (size_t c = 0; c < text.size(); )
+		{
+			int glyph = findGlyph(font, nextCodepoint(text, c));
+			const unsigned char* row = &font.bitmaps[glyph * glyphSize];
+			GLfloat ypos = y + font.height;
+
+			for (int i = 0; i < font.height; i++, row += font.rowBytes)
+			{
+				for (int b = 0; b < font.width; b++)
+				{
+					if (!(row[b >> 3] & (0x80 >> (b & 7))))
+						continue;
+
+					int start = b;
+					while (b + 1 < font.width && (row[(b + 1) >> 3] & (0x80 >> ((b + 1) & 7))))
+						b++;
+					run(x + start * size, ypos, (GLfloat)((b + 1 - start) * size), (GLfloat)size);
+				}
+				ypos -= size;
+			}
+			x += font.advances[glyph] * size;
+		}
+	}
+
+	/**
+	 Record 8x8 pixel text into a frame batch, see drawText
+	*/
+	void batchText(FrameBatch& batch, float x, float y, std::string_view text, int size, unsigned int color)
+	{
+		AllocationScope scope;
+
+		size_t first = batch.indices.size();
+		PackedColor packed = packColor(color);
+
+		// every run of the string goes into a single command
+		textRuns(x, y, text, size, [&batch, packed](GLfloat xr, GLfloat yr, GLfloat width, GLfloat height) {
+			addQuad(batch, xr, yr, width, height, packed);
+		});
+
+		addCommand(batch, { PrimitiveText, 0, false, 0, BlendOpaque, false, {} }, first);
+	}
+
+	/**
+	 Record text in a bitmap font into a frame batch, see drawText
+	*/
+	void batchFontText(FrameBatch& batch, float x, float y, std::string_view text, const BitmapFont& font, int size,
+		unsigned int color)
+	{
+		AllocationScope scope;
+
+		if (font.glyphCount == 0)
+			return;
+
+		size_t first = batch.indices.size();
+		PackedColor packed = packColor(color);
+
+		fontRuns(x, y, text, font, size, [&batch, packed](GLfloat xr, GLfloat yr, GLfloat width, GLfloat height) {
+			addQuad(batch, xr, yr, width, height, packed);
+		});
+
+		addCommand(batch, { PrimitiveText, 0, false, 0, BlendOpaque, false, {} }, first);
+	}
+
+	/**
+	 Record the kept geometry of a TextBlock into a frame batch
+	*/
+	void batchTextBlock(FrameBatch& batch, float x, float y, const TextBlockData& block)
+	{
+		AllocationScope scope;
+
+		size_t first = batch.indices.size();
+		GLuint base = (GLuint)batch.vertices.size();
+
+		for (const Vertex& vertex : block.vertices)
+			batch.vertices.push_back({ vertex.x + x, vertex.y + y, batch.vertexZ, 0, 0, vertex.color });
+		for (GLuint quad = base; quad < (GLuint)batch.vertices.size(); quad += 4)
+		{
+			batch.indices.insert(batch.indices.end(), {
+				quad, quad + 1, quad + 2,
+				quad, quad + 2, quad + 3
+			});
+		}
+
+		addCommand(batch, { PrimitiveText, 0, false, 0, BlendOpaque, false, {} }, first);
+	}
+
+	/**
+	 Build the geometry of a TextBlock at 0, 0 from its text and size
+	*/
+	void layoutTextBlock(TextBlockData& block)
+	{
+		PackedColor packed = packColor(block.color);
+
+		// four corners per run, in the order addQuad adds them
+		block.vertices.clear();
+		textRuns(0, 0, block.text, block.size, [&block, packed](GLfloat x, GLfloat y, GLfloat width, GLfloat height) {
+			block.vertices.insert(block.vertices.end(), {
+				{ x, y, 0, 0, 0, packed },
+				{ x + width, y, 0, 0, 0, packed },
+				{ x + width, y + height, 0, 0, 0, packed },
+				{ x, y + height, 0, 0, 0, packed }
+			});
+		});
+	}
+
+	/**
+	 Record text laid out in a box into a frame batch, see drawTextBox
+	*/
+	void batchTextBox(FrameBatch& batch, const Rect& box, std::string_view text, int size, unsigned int color,
+		int align, bool wrap)
+	{
+		AllocationScope scope;
+
+		if (size <= 0 || box.width <= 0 || box.height <= 0)
+			return;
+
+		size_t first = batch.indices.size();
+		PackedColor packed = packColor(color);
+		float right = box.x + box.width;
+		float top = box.y + box.height;
+		int cell = 8 * size;
+
+		auto clipped = [&batch, &box, packed, right, top](GLfloat x, GLfloat y, GLfloat width, GLfloat height) {
+			GLfloat left = std::max(x, box.x);
+			GLfloat bottom = std::max(y, box.y);
+			width = std::min(x + width, right) - left;
+			height = std::min(y + height, top) - bottom;
+			if (width > 0 && height > 0)
+				addQuad(batch, left, bottom, width, height, packed);
+		};
+
+		std::lock_guard<std::mutex> lock(s_layouts.mutex);
+		const TextLayout& layout = findLayout(text, wrap ? wrapColumns(box.width, size) : 0);
+
+		// text drawn at y covers y + 8 - 7 * size up to y + 8 + size
+		float y = top - 8 - size;
+		for (const TextLine& line : layout.lines)
+		{
+			if (y + 8 + size <= box.y)
+				break;
+
+			float width = (float)line.length * cell;
+			float x = box.x;
+			if (align == AlignCenter)
+				x += std::floor((box.width - width) / 2);
+			else if (align == AlignRight)
+				x += box.width - width;
+
+			// only the characters that reach into the box
+			float skip = x < box.x ? std::floor((box.x - x) / cell) : 0;
+			float stop = std::max(std::ceil((right - x) / cell), 0.0f);
+			uint32_t from = (uint32_t)std::min(skip, (float)line.length);
+			uint32_t to = (uint32_t)std::min(stop, (float)line.length);
+			if (from < to)
+				textRuns(x + from * cell, y, std::string_view(layout.text).substr(line.start + from, to - from),
+					size, clipped);
+
+			y -= cell;
+		}
+
+		addCommand(batch, { PrimitiveText, 0, false, 0, BlendOpaque, false, {} }, first);
+	}
+
+	/**
+	 Record a sprite into a frame batch, see drawSprite.  A batch that
+	 defers textures leaves the texture coordinates for mergeCommandList
+	 to fill in, since only the main thread may read the texture table.
+	 Parameters
+		source	- part of the texture to draw, null for all of it
+	*/
+	void batchSprite(FrameBatch& batch, const Texture& texture, const Rect* source, float x, float y,
+		float width, float height, float rotation, unsigned int tint, int flip)
+	{
+		AllocationScope scope;
+
+		// textures still loading draw as a solid quad in the tint color
+		const TextureSlot* slot = nullptr;
+		if (!batch.deferTextures)
+		{
+			slot = findTexture(texture.id);
+			if (!slot && !textureLoading(texture.id))
+				return;
+		}
+
+		size_t first = batch.indices.size();
+		PackedColor packed = packColor(tint);
+
+		GLfloat u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+		if (slot)
+			spriteCoordinates(*slot, texture, source, flip, u0, v0, u1, v1);
+
+		// corners relative to the center, rotated
+		GLfloat halfWidth = width / 2;
+		GLfloat halfHeight = height / 2;
+		GLfloat centerX = x + halfWidth;
+		GLfloat centerY = y + halfHeight;
+		GLfloat angle = (GLfloat)(rotation * M_PI / 180.0);
+		GLfloat c = cos(angle);
+		GLfloat s = sin(angle);
+
+		auto corner = [&](GLfloat dx, GLfloat dy, GLfloat u, GLfloat v) {
+			return addVertex(batch, centerX + dx * c - dy * s, centerY + dx * s + dy * c, packed, u, v);
+		};
+
+		GLuint bottomLeft = corner(-halfWidth, -halfHeight, u0, v1);
+		GLuint bottomRight = corner(halfWidth, -halfHeight, u1, v1);
+		GLuint topRight = corner(halfWidth, halfHeight, u1, v0);
+		GLuint topLeft = corner(-halfWidth, halfHeight, u0, v0);
+
+		batch.indices.insert(batch.indices.end(), {
+			bottomLeft, bottomRight, topRight,
+			bottomLeft, topRight, topLeft
+		});
+
+		if (batch.deferTextures)
+		{
+			SpriteFixup fixup = { bottomLeft, texture, {}, source != nullptr, flip };
+			if (source)
+				fixup.source = *source;
+			batch.fixups.push_back(fixup);
+		}
+
+		addCommand(batch, { PrimitiveFilled, 0, false, slot || batch.deferTextures ? texture.id : 0, BlendOpaque, false, {} }, first);
+	}
+
+	/**
+	 Record text in a distance field font into a frame batch, one quad
+	 per glyph turned around x, y, see drawText.  Like sprites, a batch
+	 that defers textures leaves the coordinates for mergeCommandList.
+	*/
+	void batchSdfText(FrameBatch& batch, float x, float y, std::string_view text, const SdfFont& font, float scale,
+		float rotation, unsigned int color)
+	{
+		AllocationScope scope;
+
+		if (font.count == 0 || scale <= 0)
+			return;
+
+		const TextureSlot* slot = nullptr;
+		if (!batch.deferTextures)
+		{
+			slot = findTexture(font.texture.id);
+			if (!slot)
+				return;
+		}
+
+		size_t first = batch.indices.size();
+		PackedColor packed = packColor(color);
+
+		GLfloat width = font.glyphWidth * scale;
+		GLfloat height = font.glyphHeight * scale;
+		int cellWidth = font.glyphWidth * SDF_RESOLUTION + 2 * SDF_SPREAD;
+		int cellHeight = font.glyphHeight * SDF_RESOLUTION + 2 * SDF_SPREAD;
+		GLfloat angle = (GLfloat)(rotation * M_PI / 180.0);
+		GLfloat c = cos(angle);
+		GLfloat s = sin(angle);
+
+		auto corner = [&](GLfloat dx, GLfloat dy, GLfloat u, GLfloat v) {
+			return addVertex(batch, x + dx * c - dy * s, y + dx * s + dy * c, packed, u, v);
+		};
+
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			int glyph = (unsigned char)text[i] - font.first;
+			if (text[i] == ' ' || glyph < 0 || glyph >= font.count)
+				continue;
+
+			// the glyph inside its padded cell
+			Rect source = {
+				(float)(glyph % font.columns * cellWidth + SDF_SPREAD),
+				(float)(glyph / font.columns * cellHeight + SDF_SPREAD),
+				(float)(font.glyphWidth * SDF_RESOLUTION),
+				(float)(font.glyphHeight * SDF_RESOLUTION)
+			};
+
+			GLfloat u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+			if (slot)
+				spriteCoordinates(*slot, font.texture, &source, FlipNone, u0, v0, u1, v1);
+
+			GLfloat left = i * width;
+			GLuint bottomLeft = corner(left, 0, u0, v1);
+			GLuint bottomRight = corner(left + width, 0, u1, v1);
+			GLuint topRight = corner(left + width, height, u1, v0);
+			GLuint topLeft = corner(left, height, u0, v0);
+
+			batch.indices.insert(batch.indices.end(), {
+				bottomLeft, bottomRight, topRight,
+				bottomLeft, topRight, topLeft
+			});
+
+			if (batch.deferTextures)
+				batch.fixups.push_back({ bottomLeft, font.texture, source, true, FlipNone });
+		}
+
+		addCommand(batch, { PrimitiveText, 0, false, font.texture.id, BlendOpaque, true, {} }, first);
+	}
+
+	/**
+	 Work out the texture coordinates of a sprite in texels, v runs down
+	 the image; the texture matrix scales them to 0..1 when drawn so atlas
+	 pages can grow
+	 Parameters
+		slot	- texture table entry of the sprite's texture
+		source	- part of the texture to draw, null for all of it
+		u0, v0	- receive the top left corner
+		u1, v1	- receive the bottom right corner, swapped with u0 and v0 by flip
+	*/
+	void spriteCoordinates(const TextureSlot& slot, const Texture& texture, const Rect* source, int flip,
+		GLfloat& u0, GLfloat& v0, GLfloat& u1, GLfloat& v1)
+	{
+		Rect whole = { 0, 0, (float)texture.width, (float)texture.height };
+
+		// async handles are 0 by 0 until textureReady fills them in
+		if (texture.width == 0 && texture.height == 0)
+		{
+			whole.width = (float)(slot.width - slot.originX);
+			whole.height = (float)(slot.height - slot.originY);
+		}
+		if (!source)
+			source = &whole;
+
+		u0 = (GLfloat)(slot.originX + texture.x) + source->x;
+		v0 = (GLfloat)(slot.originY + texture.y) + source->y;
+		u1 = u0 + source->width;
+		v1 = v0 + source->height;
+
+		if (flip & FlipHorizontal)
+			std::swap(u0, u1);
+		if (flip & FlipVertical)
+			std::swap(v0, v1);
+	}
+
+	/**
+	 Append a vertex to a frame batch
+	 Returns:
+		GLuint	- index of the new vertex
+	*/
+	GLuint addVertex(FrameBatch& batch, float x, float y, PackedColor color, GLfloat u, GLfloat v)
+	{
+		GLuint index = (GLuint)batch.vertices.size();
+		batch.vertices.push_back({ x, y, batch.vertexZ, u, v, color });
+		return index;
+	}
+
+	/**
+	 Append a rectangle to a frame batch as two triangles, so quads batch
+	 with every other filled shape
+	*/
+	void addQuad(FrameBatch& batch, float x, float y, float width, float height, PackedColor color)
+	{
+		GLuint bottomLeft = addVertex(batch, x, y, color);
+		GLuint bottomRight = addVertex(batch, x + width, y, color);
+		GLuint topRight = addVertex(batch, x + width, y + height, color);
+		GLuint topLeft = addVertex(batch, x, y + height, color);
+
+		batch.indices.insert(batch.indices.end(), {
+			bottomLeft, bottomRight, topRight,
+			bottomLeft, topRight, topLeft
+		});
+	}
+
+	/**
+	 Append a line segment to a frame batch as a quad half a width either
+	 side of it
+	 Parameters
+		direction	- unit vector from start to end
+		half		- half the line width
+	*/
+	void addSegment(FrameBatch& batch, Point start, Point end, Point direction, float half, PackedColor color)
+	{
+		float nx = -direction.y * half;
+		float ny = direction.x * half;
+
+		GLuint startLeft = addVertex(batch, start.x + nx, start.y + ny, color);
+		GLuint startRight = addVertex(batch, start.x - nx, start.y - ny, color);
+		GLuint endRight = addVertex(batch, end.x - nx, end.y - ny, color);
+		GLuint endLeft = addVertex(batch, end.x + nx, end.y + ny, color);
+
+		batch.indices.insert(batch.indices.end(), {
+			startLeft, startRight, endRight,
+			startLeft, endRight, endLeft
+		});
+	}
+
+	/**
+	 Fill the gap on the outer side of the corner between two segments
+	 Parameters
+		point	- where the segments meet
+		before	- unit direction of the segment ending at point
+		after	- unit direction of the segment starting at point
+		half	- half the line width
+		join	- LineJoin
+	*/
+	void addJoin(FrameBatch& batch, Point point, Point before, Point after, float half, int join, PackedColor color)
+	{
+		float cross = before.x * after.y - before.y * after.x;
+		float dot = before.x * after.x + before.y * after.y;
+
+		// straight on, the segments already meet
+		if (fabs(cross) < 1e-6f && dot > 0)
+			return;
+
+		// the outer side of a left turn is on the right
+		float side = cross > 0 ? -half : half;
+		Point outBefore = { -before.y * side, before.x * side };
+		Point outAfter = { -after.y * side, after.x * side };
+
+		if (join == JoinRound)
+		{
+			float angle = acos(std::max(-1.0f, std::min(1.0f, dot)));
+			addArc(batch, point, outBefore, cross > 0 ? angle : -angle, half, color);
+			return;
+		}
+
+		GLuint center = addVertex(batch, point.x, point.y, color);
+		GLuint edgeBefore = addVertex(batch, point.x + outBefore.x, point.y + outBefore.y, color);
+		GLuint edgeAfter = addVertex(batch, point.x + outAfter.x, point.y + outAfter.y, color);
+		batch.indices.insert(batch.indices.end(), { center, edgeBefore, edgeAfter });
+
+		// the tip is 1 / cos(turn / 2) half widths out
+		float cosHalfTurn = sqrt(std::max(0.0f, (1 + dot) / 2));
+		if (join != JoinMiter || cosHalfTurn * MITER_LIMIT * 2 < 1)
+			return;
+
+		float mx = outBefore.x + outAfter.x;
+		float my = outBefore.y + outAfter.y;
+		float scale = 1 / (2 * cosHalfTurn * cosHalfTurn);
+		GLuint tip = addVertex(batch, point.x + mx * scale, point.y + my * scale, color);
+		batch.indices.insert(batch.indices.end(), { edgeBefore, tip, edgeAfter });
+	}
+
+	/**
+	 Append a fan of triangles covering an arc of a circle, for round
+	 joins and caps.  The steps keep the edge within a quarter pixel of
+	 the true arc.
+	 Parameters
+		center	- of the circle
+		start	- vector from the center to where the arc starts
+		angle	- counter-clockwise sweep in radians, negative for clockwise
+		radius	- length of start
+	*/
+	void addArc(FrameBatch& batch, Point center, Point start, float angle, float radius, PackedColor color)
+	{
+		float limit = radius > 0.25f ? 2 * acos(1 - 0.25f / radius) : (float)M_PI;
+		int steps = std::max(1, std::min(MAX_ARC_STEPS, (int)ceil(fabs(angle) / limit)));
+
+		// rotate the start vector instead of calling cos and sin every step
+		GLfloat stepCos = cos(angle / steps);
+		GLfloat stepSin = sin(angle / steps);
+		GLfloat dx = start.x;
+		GLfloat dy = start.y;
+
+		GLuint middle = addVertex(batch, center.x, center.y, color);
+		GLuint previous = addVertex(batch, center.x + dx, center.y + dy, color);
+		for (int i = 0; i < steps; i++)
+		{
+			GLfloat next = dx * stepCos - dy * stepSin;
+			dy = dx * stepSin + dy * stepCos;
+			dx = next;
+
+			GLuint index = addVertex(batch, center.x + dx, center.y + dy, color);
+			batch.indices.insert(batch.indices.end(), { middle, previous, index });
+			previous = index;
+		}
+	}
+
+	/**
+	 Find or add a render state in this frame's state table.  States
+	 rarely change so the last match is checked before searching.
+	 Returns:
+		size_t	- index of the state
+	*/
+	size_t findState(FrameBatch& batch, const BatchState& state)
+	{
+		std::vector<BatchState>& states = batch.states;
+
+		auto same = [&state](const BatchState& other) {
+			return other.type == state.type && other.size == state.size
+				&& other.smooth == state.smooth && other.texture == state.texture
+				&& other.blend == state.blend && other.distanceField == state.distanceField;
+		};
+
+		if (batch.lastState < states.size() && same(states[batch.lastState]))
+			return batch.lastState;
+
+		for (size_t i = 0; i < states.size(); i++)
+		{
+			if (same(states[i]))
+				return batch.lastState = i;
+		}
+
+		// table full, share the last state rather than lose the draw, and
+		// count it so the wrong state shows in the frame stats
+		if (states.size() == MAX_BATCH_STATES)
+		{
+			batch.sharedStates++;
+			return batch.lastState = states.size() - 1;
+		}
+
+		states.push_back(state);
+		return batch.lastState = states.size() - 1;
+	}
+
+	/**
+	 Record a draw command covering the indices added since firstIndex.
+	 With a depth buffer, draws that blend sort after every opaque draw
+	 and back to front, since they need what is behind them drawn first.
+	 Parameters
+		state		- render state needed to draw the indices, its blend
+					  mode is the batch's
+		firstIndex	- size of the index list before the draw added to it
+	*/
+	void addCommand(FrameBatch& batch, BatchState state, size_t firstIndex)
+	{
+		size_t count = batch.indices.size() - firstIndex;
+		if (count == 0)
+			return;
+
+		state.blend = batch.blend;
+		if (batch.multisample)
+			state.smooth = false;
+		uint64_t order = batch.order;
+		if (batch.depthBuffer && state.blend != BlendOpaque)
+			order = KEY_BLENDED_PASS | (0xFFFFFF - order);
+
+		uint64_t key = order << KEY_ORDER_SHIFT
+			| (uint64_t)state.type << KEY_TYPE_SHIFT
+			| (uint64_t)findState(batch, state) << KEY_STATE_SHIFT;
+
+		batch.commands.push_back({ key, (GLuint)firstIndex, (GLuint)count });
+	}
+
+	/**
+	 Work out the sort order and vertex depth for the current layer and
+	 depth.  Both are a 24-bit value made from the layer (16 bits) and the
+	 depth (8 bits).  Painted back to front the order is the layer, then
+	 deepest first.  With a depth buffer it is the distance from the
+	 viewer, so opaque draws go front to back and hidden pixels fail the
+	 depth test; that same value is the vertex z in the 0..1 glOrtho range.
+	*/
+	void updateDepth(FrameBatch& batch)
+	{
+		uint64_t layer = (uint64_t)(batch.layer + 32768);
+		uint64_t depth = (uint64_t)lround(batch.depth * 255);
+		uint64_t distance = (0xFFFF - layer) << 8 | depth;
+
+		if (batch.depthBuffer)
+			batch.order = distance;
+		else
+			batch.order = layer << 8 | (0xFF - depth);
+
+		// eye space looks down -z, exact in a float for 24-bit values
+		batch.vertexZ = -(GLfloat)distance / (GLfloat)(1 << 24);
+	}
+
+	/**
+	 Returns the buffers windowPaint needs to clear
+	 Returns:
+		GLbitfield	- mask for glClear
+	*/
+	GLbitfield clearMask(const FrameBatch& batch)
+	{
+		if (batch.depthBuffer)
+			return GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT;
+		return GL_COLOR_BUFFER_BIT;
+	}
+
+	/**
+	 Stable LSD radix sort of the frame commands by key, one byte per pass.
+	 Passes where every key has the same byte are skipped, which is most
+	 of them since the low bits of the key are rarely used.
+	*/
+	void sortCommands(FrameBatch& batch)
+	{
+		size_t count = batch.commands.size();
+		SortItem* items = batch.sorted = batch.scratch.allocate<SortItem>(count);
+		SortItem* temp = batch.scratch.allocate<SortItem>(count);
+
+		// histogram every byte in one pass over the keys, large frames in
+		// chunks on the job threads with a histogram per chunk
+		int chunks = (int)std::min<size_t>(jobWorkers() + 1, count / PARALLEL_COMMANDS + 1);
+		batch.histograms = batch.scratch.allocate<size_t>((size_t)chunks * 8 * 256);
+		std::fill(batch.histograms, batch.histograms + (size_t)chunks * 8 * 256, 0);
+
+		parallelFor(chunks, 1, [&batch, chunks](int first, int last) {
+			size_t count = batch.commands.size();
+
+			for (int chunk = first; chunk < last; chunk++)
+			{
+				size_t* counts = &batch.histograms[(size_t)chunk * 8 * 256];
+				size_t end = count * (chunk + 1) / chunks;
+
+				for (size_t i = count * chunk / chunks; i < end; i++)
+				{
+					uint64_t key = batch.commands[i].key;
+					batch.sorted[i] = { key, (GLuint)i };
+					for (int pass = 0; pass < 8; pass++)
+						counts[pass * 256 + ((key >> (pass * 8)) & 0xFF)]++;
+				}
+			}
+		});
+
+		size_t histogram[8][256] = {};
+		for (int chunk = 0; chunk < chunks; chunk++)
+		{
+			const size_t* counts = &batch.histograms[(size_t)chunk * 8 * 256];
+			for (int b = 0; b < 8 * 256; b++)
+				histogram[b / 256][b % 256] += counts[b];
+		}
+
+		for (int pass = 0; pass < 8; pass++)
+		{
+			size_t* buckets = histogram[pass];
+			int shift = pass * 8;
+
+			if (buckets[(items[0].key >> shift) & 0xFF] == count)
+				continue;
+
+			// bucket counts to starting offsets
+			size_t offset = 0;
+			for (int b = 0; b < 256; b++)
+			{
+				size_t bucketCount = buckets[b];
+				buckets[b] = offset;
+				offset += bucketCount;
+			}
+
+			for (size_t i = 0; i < count; i++)
+				temp[buckets[(items[i].key >> shift) & 0xFF]++] = items[i];
+
+			std::swap(items, temp);
+		}
+
+		batch.sorted = items;
+	}
+
+	/**
+	 Returns true if two states can be drawn by the same call.  Shapes
+	 (texture 0) join any texture since they only use its white texel.
+	*/
+	bool canMerge(const BatchState& run, const BatchState& state)
+	{
+		return run.type == state.type && run.size == state.size && run.smooth == state.smooth
+			&& run.blend == state.blend && run.distanceField == state.distanceField
+			&& (run.texture == state.texture || run.texture == 0 || state.texture == 0);
+	}
+
+	/**
+	 Apply a batch state to OpenGL, skipping settings the context's state
+	 cache shows are already in effect
+	 Parameters
+		context	- context being drawn
+		state	- state to apply
+	*/
+	void applyState(ContextData& context, const BatchState& state)
+	{
+		const BatchState* current = context.cache.valid ? &context.cache.state : nullptr;
+
+		// texture coordinates are in texels, scale them to the bound texture
+		if (!current || current->texture != state.texture)
+		{
+			const TextureBinding& binding = state.binding;
+
+			glBindTexture(GL_TEXTURE_2D, binding.name ? binding.name : context.whiteTexture);
+			glMatrixMode(GL_TEXTURE);
+			glLoadIdentity();
+			if (binding.name)
+				glScalef(1.0f / binding.width, 1.0f / binding.height, 1.0f);
+			glMatrixMode(GL_MODELVIEW);
+		}
+
+		if (state.type == PrimitivePoints)
+		{
+			if (!current || current->type != PrimitivePoints || current->size != state.size)
+				glPointSize(state.size);
+			if (state.smooth)
+				glEnable(GL_POINT_SMOOTH);
+			else
+				glDisable(GL_POINT_SMOOTH);
+		}
+		else if (state.type == PrimitiveLines)
+		{
+			if (!current || current->type != PrimitiveLines || current->size != state.size)
+				glLineWidth(state.size);
+			if (state.smooth)
+				glEnable(GL_LINE_SMOOTH);
+			else
+				glDisable(GL_LINE_SMOOTH);
+		}
+
+		// blended pixels only leave out the fully transparent, and keep
+		// out of the depth buffer so later draws behind them still show.
+		// Distance fields always cut at 0.5, their alpha is the edge.
+		if (!current || current->blend != state.blend || current->distanceField != state.distanceField)
+		{
+			switch (state.blend)
+			{
+			case BlendAlpha:
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				break;
+			case BlendAdditive:
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+				break;
+			case BlendMultiply:
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_DST_COLOR, GL_ZERO);
+				break;
+			default:
+				glDisable(GL_BLEND);
+				break;
+			}
+			glAlphaFunc(GL_GREATER, state.blend == BlendOpaque || state.distanceField ? 0.5f : 0.0f);
+			glDepthMask(state.blend == BlendOpaque ? GL_TRUE : GL_FALSE);
+		}
+
+		context.cache.state = state;
+		context.cache.valid = true;
+	}
+
+	/**
+	 Sort the frame's commands, merge runs that share render state and
+	 draw each run with one glDrawElements call, then empty the batch
+	 for the next frame.  Buffers keep their capacity between frames.
+	*/
+	void submitBatch(ContextData& context, FrameBatch& batch)
+	{
+		static const GLenum modes[] = { GL_TRIANGLES, GL_LINES, GL_POINTS, GL_TRIANGLES };
+
+		FrameStats stats = {};
+		stats.commands = (unsigned int)batch.commands.size();
+		stats.vertices = (unsigned int)batch.vertices.size();
+		stats.sharedStates = batch.sharedStates;
+
+		if (!batch.commands.empty())
+		{
+			sortCommands(batch);
+			context.cache.valid = false;
+
+			// sprites modulate texels with the vertex color, alpha test
+			// leaves transparent pixels out, see applyState for blending
+			glPushAttrib(GL_POINT_BIT | GL_LINE_BIT | GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT
+				| GL_DEPTH_BUFFER_BIT);
+			glEnable(GL_TEXTURE_2D);
+			glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+			glEnable(GL_ALPHA_TEST);
+			glAlphaFunc(GL_GREATER, 0.5f);
+
+			glEnableClientState(GL_VERTEX_ARRAY);
+			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+			glEnableClientState(GL_COLOR_ARRAY);
+			glVertexPointer(3, GL_FLOAT, sizeof(Vertex), &batch.vertices[0].x);
+			glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), &batch.vertices[0].u);
+			glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), &batch.vertices[0].color);
+
+			// split the sorted commands into runs, a new run where the state
+			// changes, and find where each command's indices go
+			size_t count = batch.commands.size();
+			DrawRun* runs = batch.scratch.allocate<DrawRun>(count);
+			size_t runCount = 0;
+			batch.gatherOffsets = batch.scratch.allocate<GLuint>(count);
+			GLuint offset = 0;
+
+			for (size_t i = 0; i < count; i++)
+			{
+				const BatchState& state = batch.states[batch.sorted[i].key >> KEY_STATE_SHIFT & KEY_STATE_MASK];
+
+				// a run of shapes takes the texture of the first sprite to join it
+				if (runCount == 0 || !canMerge(runs[runCount - 1].state, state))
+					runs[runCount++] = { state, offset, 0 };
+				else if (runs[runCount - 1].state.texture == 0)
+				{
+					runs[runCount - 1].state.texture = state.texture;
+					runs[runCount - 1].state.binding = state.binding;
+				}
+
+				GLuint indexCount = batch.commands[batch.sorted[i].command].indexCount;
+				batch.gatherOffsets[i] = offset;
+				runs[runCount - 1].indexCount += indexCount;
+				offset += indexCount;
+			}
+
+			// gather indices in sorted order so each run is contiguous,
+			// large frames on the job threads
+			batch.submitIndices = batch.scratch.allocate<GLuint>(offset);
+			parallelFor((int)count, PARALLEL_COMMANDS, [&batch](int first, int last) {
+				for (int i = first; i < last; i++)
+				{
+					const DrawCommand& command = batch.commands[batch.sorted[i].command];
+					std::copy(batch.indices.begin() + command.firstIndex,
+						batch.indices.begin() + command.firstIndex + command.indexCount,
+						batch.submitIndices + batch.gatherOffsets[i]);
+				}
+			});
+
+			for (size_t i = 0; i < runCount; i++)
+			{
+				applyState(context, runs[i].state);
+				glDrawElements(modes[runs[i].state.type], (GLsizei)runs[i].indexCount,
+					GL_UNSIGNED_INT, batch.submitIndices + runs[i].firstIndex);
+				stats.batches++;
+			}
+
+			glDisableClientState(GL_COLOR_ARRAY);
+			glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+			glDisableClientState(GL_VERTEX_ARRAY);
+			glMatrixMode(GL_TEXTURE);
+			glLoadIdentity();
+			glMatrixMode(GL_MODELVIEW);
+			glPopAttrib();
+		}
+
+		stats.scratchBytes = batch.scratch.used();
+		stats.scratchHighWater = batch.scratch.highWater();
+
+		resetBatch(batch);
+		batch.stats = stats;
+	}
+
+	/**
+	 Look up the OpenGL texture of every state in a frame, on the main
+	 thread which owns the texture table
+	*/
+	void resolveTextures(FrameBatch& batch)
+	{
+		for (BatchState& state : batch.states)
+		{
+			const TextureSlot* slot = findTexture(state.texture);
+
+			if (slot)
+				state.binding = { slot->name, slot->width, slot->height };
+			else
+				state.binding = {};
+		}
+	}
+
+	/**
+	 Empty a frame batch, buffers keep their capacity
+	*/
+	void resetBatch(FrameBatch& batch)
+	{
+		batch.vertices.clear();
+		batch.indices.clear();
+		batch.commands.clear();
+		batch.states.clear();
+		batch.fixups.clear();
+		batch.lastState = 0;
+		batch.sharedStates = 0;
+		batch.scratch.reset();
+	}
 
 	/**
-	 Set the global OpenGL 3-float color matrix to an integer color RGB
+	 Append the draws of one frame batch to another, which may use a
+	 different state table
 	 Parameters
-		color - 3-byte value in RGB form
+		target		- batch to add to
+		source		- batch to copy, unchanged
+		stateMap	- scratch buffer reused between calls
+	*/
+	void appendBatch(FrameBatch& target, const FrameBatch& source, std::vector<GLuint>& stateMap)
+	{
+		GLuint vertexBase = (GLuint)target.vertices.size();
+		GLuint indexBase = (GLuint)target.indices.size();
+
+		target.sharedStates += source.sharedStates;
+
+		target.vertices.insert(target.vertices.end(), source.vertices.begin(), source.vertices.end());
+		for (GLuint index : source.indices)
+			target.indices.push_back(index + vertexBase);
+
+		// command lists do not know if the window multisamples
+		stateMap.resize(source.states.size());
+		for (size_t i = 0; i < source.states.size(); i++)
+		{
+			BatchState state = source.states[i];
+			if (target.multisample)
+				state.smooth = false;
+			stateMap[i] = (GLuint)findState(target, state);
+		}
+
+		for (const DrawCommand& command : source.commands)
+		{
+			uint64_t state = command.key >> KEY_STATE_SHIFT & KEY_STATE_MASK;
+			uint64_t key = (command.key & ~(KEY_STATE_MASK << KEY_STATE_SHIFT))
+				| (uint64_t)stateMap[state] << KEY_STATE_SHIFT;
+
+			target.commands.push_back({ key, command.firstIndex + indexBase, command.indexCount });
+		}
+
+		if (target.deferTextures)
+		{
+			for (SpriteFixup fixup : source.fixups)
+			{
+				fixup.firstVertex += vertexBase;
+				target.fixups.push_back(fixup);
+			}
+		}
+	}
+
+	/**
+	 Add the draws submitted by a context's command lists to its frame.
+	 Runs on the main thread, so sprite texture coordinates and states can
+	 be worked out from the texture table here.
 	*/
-	void setColor(unsigned int color)
+	void mergeCommandLists(ContextData& context)
 	{
-		GLfloat red = ((color >> 16) & 0xFF) / 255.0;
-		GLfloat green = ((color >> 8) & 0xFF) / 255.0;
-		GLfloat blue = (color & 0xFF) / 255.0;
-		glColor3f(red, green, blue);
+		std::lock_guard<std::mutex> lock(context.listMutex);
+		FrameBatch& batch = context.batch;
+
+		for (CommandListData* list : context.lists)
+		{
+			FrameBatch& source = list->submitted;
+			if (source.commands.empty())
+				continue;
+
+			for (const SpriteFixup& fixup : source.fixups)
+			{
+				Vertex* corners = &source.vertices[fixup.firstVertex];
+				const TextureSlot* slot = findTexture(fixup.texture.id);
+				GLfloat u0, v0, u1, v1;
+
+				if (slot)
+				{
+					spriteCoordinates(*slot, fixup.texture, fixup.hasSource ? &fixup.source : nullptr,
+						fixup.flip, u0, v0, u1, v1);
+					corners[0].u = u0;
+					corners[0].v = v1;
+					corners[1].u = u1;
+					corners[1].v = v1;
+					corners[2].u = u1;
+					corners[2].v = v0;
+					corners[3].u = u0;
+					corners[3].v = v0;
+				}
+				else if (!textureLoading(fixup.texture.id))
+				{
+					// freed texture, collapse the quad so nothing is drawn
+					for (int i = 1; i < 4; i++)
+					{
+						corners[i].x = corners[0].x;
+						corners[i].y = corners[0].y;
+					}
+				}
+			}
+
+			// sprites of textures still loading keep coordinates 0,0 and
+			// draw from the white texel like shapes
+			for (BatchState& state : source.states)
+			{
+				if (!findTexture(state.texture))
+					state.texture = 0;
+			}
+
+			// lists record in depth buffer order, which is painter's order
+			// reversed; blended draws already hold painter's order
+			if (!batch.depthBuffer)
+			{
+				for (DrawCommand& command : source.commands)
+				{
+					uint64_t order = command.key >> KEY_ORDER_SHIFT;
+					order = order & KEY_BLENDED_PASS ? order & ~KEY_BLENDED_PASS : 0xFFFFFF - order;
+					command.key = order << KEY_ORDER_SHIFT | (command.key & ((1ull << KEY_ORDER_SHIFT) - 1));
+				}
+			}
+
+			appendBatch(batch, source, list->stateMap);
+			resetBatch(source);
+		}
 	}
 
 } // namespace fgcugl
@@ -7,15 +7,30 @@
 // 2D graphics library built on OpenGL and Glew
 // --------------------------------------------------------
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <memory>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include "fgcugl_alloc.h"
+#include "fgcugl_arena.h"
+#include "fgcugl_font.h"
+#include "fgcugl_image.h"
+#include "fgcugl_jobs.h"
+#include "fgcugl_pack.h"
+
 #ifndef FGCUGL_H
 #define FGCUGL_H
 
 namespace fgcugl
 {
+	/**
+	 Colors are 0xTTRRGGBB, where TT is transparency: 0 is opaque, so plain
+	 24-bit colors like these draw solid, and 255 is invisible.  Make
+	 translucent colors with rgba and draw them with a BlendMode.
+	*/
 	enum Color {
 		Black = 0x000000,
 		White = 0xFFFFFF,
@@ -36,6 +51,44 @@ namespace fgcugl
 		Navy = 0x000080
 	};
 
+	/**
+	 Make a color with an alpha channel
+	 Parameters:
+		red		- 0..255
+		green	- 0..255
+		blue	- 0..255
+		alpha	- 0 (invisible) to 255 (opaque)
+	 Returns:
+		unsigned int	- color for the draw functions
+	*/
+	constexpr unsigned int rgba(int red, int green, int blue, int alpha)
+	{
+		return (unsigned int)(255 - (alpha & 0xFF)) << 24 | (unsigned int)(red & 0xFF) << 16
+			| (unsigned int)(green & 0xFF) << 8 | (unsigned int)(blue & 0xFF);
+	}
+
+	/**
+	 How draws are combined with the pixels already drawn, see setBlendMode
+	*/
+	enum BlendMode {
+		BlendOpaque = 0,	// replace, pixels less than half opaque are left out
+		BlendAlpha = 1,		// mix by alpha
+		BlendAdditive = 2,	// add, scaled by alpha, for light and glow
+		BlendMultiply = 3	// multiply, to darken and tint
+	};
+
+	/**
+	 Optional settings for openWindow
+	*/
+	struct WindowOptions
+	{
+		bool resizable = true;		// user can resize the window
+		bool depthBuffer = false;	// depth test draws by layer and depth, see setDepth
+		bool renderThread = false;	// draw and swap on a thread of its own, see windowPaint
+		int samples = 0;			// multisample anti-aliasing samples per pixel, 0 for none
+		bool headless = false;		// no visible window, frames are drawn offscreen, see readFrame
+	};
+
 	/**
 	 Initialize a new OpenGL window
 	 Parameters:
@@ -45,7 +98,22 @@ namespace fgcugl
 	 Returns:
 		void
 	*/
-	void openWindow(int width, int height, std::string title, bool resizable = true);
+	void openWindow(int width, int height, const std::string& title, bool resizable = true);
+	void openWindow(int width, int height, const char* title, bool resizable = true);
+
+	/**
+	 Initialize a new OpenGL window.  Calling it again replaces the window,
+	 keeping loaded textures, use a Context for each extra window.
+	 Parameters:
+		width - width of the window in pixels
+		height - height of the window in pixels
+		title - text to display in window titlebar
+		options - window settings, see WindowOptions
+	 Returns:
+		void
+	*/
+	void openWindow(int width, int height, const std::string& title, const WindowOptions& options);
+	void openWindow(int width, int height, const char* title, const WindowOptions& options);
 
 	/**
 	 Returns true if the OpenGL window is closing
@@ -57,11 +125,28 @@ namespace fgcugl
 	 Performs double buffering of window painting so 
 	 changes are written to one buffer while the other
 	 is being drawn, and swaps the buffers when called.
+
+	 With WindowOptions::renderThread the frame is handed to the render
+	 thread, which draws and swaps it while the program builds the next
+	 one.  windowPaint only waits if the frame before is still drawing,
+	 and getFrameStats then describes that frame.
 	 Returns:
 		void
 	*/
 	void windowPaint();
 
+	/**
+	 Copy the last frame painted by a headless window, see
+	 WindowOptions::headless.  With WindowOptions::samples the frame was
+	 drawn multisampled and is read anti-aliased.  Waits for the render
+	 thread to finish the frame if there is one.
+	 Parameters:
+		image	- receives the pixels, top row first
+	 Returns:
+		bool	- false if the window is not headless
+	*/
+	bool readFrame(Image& image);
+
 	/**
 	 Get's current program execution time in best possible precision, 
 	 typically nano or micro seconds
@@ -89,12 +174,103 @@ namespace fgcugl
 	void getEvents();
 
 	/**
-	* cleanup and exit the OpenGL environment
+	* cleanup and exit the OpenGL environment, closing every open Context
 	 Returns:
 		void
 	*/
 	void cleanup();
 
+	/**
+	 Counters describing the last frame submitted by windowPaint
+	*/
+	struct FrameStats
+	{
+		unsigned int commands;	// draw calls made by the program
+		unsigned int batches;	// OpenGL draw calls after sorting and merging
+		unsigned int vertices;	// vertices submitted
+		size_t scratchBytes;	// frame arena memory used to sort and submit
+		size_t scratchHighWater;	// most scratch memory any frame has used
+		unsigned int sharedStates;	// draws drawn with another draw's state as the state table was full, 0 normally
+	};
+
+	/**
+	 Set the layer for all following draw calls.  Drawing is deferred until
+	 windowPaint, where the frame is sorted by layer (lowest first), then
+	 by primitive type (filled shapes, lines, points, text) and render state so
+	 that as many draws as possible are merged into one OpenGL call.  Draws
+	 with the same layer, type and state keep the order they were made in.
+	 Parameters:
+		layer	- sort layer, clamped to -32768..32767 (default=0)
+	 Returns:
+		void
+	*/
+	void setLayer(int layer);
+
+	/**
+	 Returns the layer set by setLayer
+	 Returns:
+		int		- current sort layer
+	*/
+	int getLayer();
+
+	/**
+	 Set the depth of all following draw calls within their layer, from
+	 0 (front) to 1 (back).  Without a depth buffer, deeper draws in a
+	 layer are painted first.  When the window was opened with
+	 WindowOptions::depthBuffer, layers and depths are written to the depth
+	 buffer instead (higher layers in front) and the frame is drawn front
+	 to back, so pixels hidden behind earlier draws are never filled.
+	 Parameters:
+		depth	- 0..1, clamped (default=0)
+	 Returns:
+		void
+	*/
+	void setDepth(float depth);
+
+	/**
+	 Returns the depth set by setDepth
+	 Returns:
+		float	- current depth
+	*/
+	float getDepth();
+
+	/**
+	 Set how all following draw calls are combined with what is already
+	 drawn.  Draws are only merged with draws of the same mode.  With a
+	 depth buffer, draws that blend are drawn after every opaque draw of
+	 the frame, back to front, and do not write depth, so what is behind
+	 them shows through.
+	 Parameters:
+		mode	- BlendMode (default=BlendOpaque)
+	 Returns:
+		void
+	*/
+	void setBlendMode(int mode);
+
+	/**
+	 Returns the mode set by setBlendMode
+	 Returns:
+		int		- current BlendMode
+	*/
+	int getBlendMode();
+
+	/**
+	 Returns counters for the last frame painted by windowPaint
+	 Returns:
+		FrameStats	- command, batch and vertex counts
+	*/
+	FrameStats getFrameStats();
+
+	/**
+	 Returns the frame arena of the window, for scratch memory needed only
+	 until the end of the frame.  windowPaint frees everything taken from
+	 it at once, so it costs nothing to free and once it has grown to fit
+	 a frame it does not allocate.  Only the main thread may use it.
+	 Returns:
+		FrameArena&	- arena reset by windowPaint
+	*/
+	FrameArena& getFrameArena();
+
 	/**
 	 Draw a 4 sided filled block
 	 Parameters:
@@ -108,6 +284,25 @@ namespace fgcugl
 	*/
 	void drawQuad(float x, float y, float width, float height, unsigned int color = White);
 
+	/**
+	 Draw a 4 sided filled block shaded between a color at each corner.
+	 The colors blend toward the average of all four at the middle, so
+	 gradients across the block come out the same in every direction.
+	 Parameters:
+		x			- left side coordinate
+		y			- bottom coordinate
+		width		- in pixels
+		height		- in pixels
+		bottomLeft	- color of each corner
+		bottomRight
+		topRight
+		topLeft
+	 Returns:
+		void
+	*/
+	void drawQuad(float x, float y, float width, float height, unsigned int bottomLeft, unsigned int bottomRight,
+		unsigned int topRight, unsigned int topLeft);
+
 	/**
 	 Draw a scaled filled point, i.e. 1 or more pixel dot.
 	 Use drawCircle for anything more than 2-3 pixes to get a
@@ -117,14 +312,17 @@ namespace fgcugl
 		y		- vertical center
 		size	- of point in pixels (default=1)
 		color	- fill color (default=White)
-		smooth	- smooth edges of circle as best as possible (default=true)
+		smooth	- smooth edges of circle as best as possible, ignored
+				  when the window has WindowOptions::samples (default=true)
 	 Returns:
 		void
 	*/
 	void drawPoint(float x, float y, float size = 1, unsigned int color = White, bool smooth = true);
 
 	/**
-	 Draw a 4 sided filled block
+	 Draw a straight line.  Lines wider than a pixel are drawn as filled
+	 triangles with butt ends, so any width works and they batch with the
+	 filled shapes; use drawPolyline for other ends.
 	 Parameters:
 		x1		- left side coordinate for point 1
 		y1		- bottom coordinate for point 1
@@ -132,12 +330,86 @@ namespace fgcugl
 		y2		- bottom coordinate for point 2
 		width	- of line in pixels
 		color	- fill color (default=White)
-		smooth	- smooth edges angled lines as best as possible (default=true)
+		smooth	- smooth edges of 1 pixel lines as best as possible, ignored
+				  when the window has WindowOptions::samples (default=true)
 	 Returns:
 		void
 	*/
 	void drawLine(float x1, float y1, float x2, float y2, float width = 1, unsigned int color = White, bool smooth = true);
 
+	/**
+	 Point in pixels
+	*/
+	struct Point
+	{
+		float x, y;
+	};
+
+	/**
+	 How drawPolyline joins the segments of a line
+	*/
+	enum LineJoin {
+		JoinMiter = 0,	// extend the edges to a point, beveled when the point is over 4 widths away
+		JoinRound = 1,
+		JoinBevel = 2	// cut the corner off
+	};
+
+	/**
+	 How drawPolyline ends a line that is not closed
+	*/
+	enum LineCap {
+		CapButt = 0,	// square, at the end point
+		CapRound = 1,
+		CapSquare = 2	// square, half the width past the end point
+	};
+
+	/**
+	 Draw connected line segments of any width as filled triangles, one
+	 draw for the whole line that batches with the filled shapes.
+	 Parameters:
+		points	- count points, one after another along the line
+		count	- number of points, at least 2
+		width	- of line in pixels (default=1)
+		color	- fill color (default=White)
+		join	- LineJoin for the corners (default=JoinMiter)
+		cap		- LineCap for the ends (default=CapButt)
+		closed	- join the last point back to the first (default=false)
+	 Returns:
+		void
+	*/
+	void drawPolyline(const Point* points, int count, float width = 1, unsigned int color = White,
+		int join = JoinMiter, int cap = CapButt, bool closed = false);
+
+	/**
+	 Draw a filled polygon, convex or concave, as one batched draw.  The
+	 triangles are kept in a cache keyed by the points, so a polygon drawn
+	 again with the same points is not triangulated again.  Points that
+	 repeat, including a last point equal to the first, are skipped.
+	 Polygons whose edges cross are filled, but not necessarily as expected.
+	 Parameters:
+		points	- count corners in order around the edge, either direction
+		count	- number of points, at least 3
+		color	- fill color (default=White)
+	 Returns:
+		void
+	*/
+	void drawPolygon(const Point* points, int count, unsigned int color = White);
+
+	/**
+	 Draw the edge of a polygon, drawPolyline with the last point joined
+	 back to the first
+	 Parameters:
+		points	- count corners in order around the edge
+		count	- number of points, at least 2
+		width	- of line in pixels (default=1)
+		color	- fill color (default=White)
+		join	- LineJoin for the corners (default=JoinMiter)
+	 Returns:
+		void
+	*/
+	void drawPolygonOutline(const Point* points, int count, float width = 1, unsigned int color = White,
+		int join = JoinMiter);
+
 	/**
 	 Draw a filled circle made up of a triangle-fan.  360 triangles will
 	 produce a smooth circle.  6 triangles will produce a hexagon.  etc.
@@ -153,7 +425,25 @@ namespace fgcugl
 	void drawCircle(float x, float y, float radius, unsigned int color = White, int sides = 360);
 
 	/**
-	 Draw 8x8 pixel characters as text on the screen
+	 Draw a filled circle shaded from one color at the center to another
+	 at the edge, e.g. a glow or, with a transparent center and
+	 BlendAlpha, a vignette.  Drawn like drawCircle.
+	 Parameters:
+		x			- horizontal center
+		y			- vertical center
+		radius		- of circle in pixels
+		centerColor	- color at the center
+		edgeColor	- color around the edge
+		sides		- number of triangles drawn (default=360)
+	 Returns:
+		void
+	*/
+	void drawGradientCircle(float x, float y, float radius, unsigned int centerColor, unsigned int edgeColor,
+		int sides = 360);
+
+	/**
+	 Draw 8x8 pixel characters as text on the screen.  Bytes outside
+	 printable ASCII draw as ?.
 	 Parameters:
 		x		- left side of first character
 		y		- bottom of of characters
@@ -163,9 +453,675 @@ namespace fgcugl
 	 Returns:
 		void
 	*/
-	void drawText(float x, float y, std::string text, int size = 1, unsigned int color = White);
+	void drawText(float x, float y, std::string_view text, int size = 1, unsigned int color = White);
+
+	/**
+	 Draw an integer as text, formatted on the stack without building a
+	 string, for scores and counters drawn every frame
+	 Parameters:
+		x		- left side of first character
+		y		- bottom of of characters
+		value	- number to draw
+		size	- multiplier for size of characters (default=1), i.e 2=16x16
+		color	- fill color (default=White)
+	 Returns:
+		void
+	*/
+	void drawNumber(float x, float y, long long value, int size = 1, unsigned int color = White);
+
+	/**
+	 Draw printf style formatted text, formatted on the stack without
+	 building a string.  Understands the flags - + space 0, width and
+	 precision (also as *), the sizes h l ll z and the conversions
+	 d i u x X c s f F and %%.  As in printf, the precision is the least
+	 number of digits of an integer, the decimals of a float and the most
+	 characters of a string.  Floats are drawn in fixed point with at
+	 most 17 decimals, places past the 17 significant digits a double
+	 holds are drawn as 0.  Text past 255 characters is cut off.
+	 Parameters:
+		x		- left side of first character
+		y		- bottom of of characters
+		size	- multiplier for size of characters, i.e 2=16x16
+		color	- fill color
+		format	- printf style format, followed by its arguments
+	 Returns:
+		void
+	*/
+	void drawFormatted(float x, float y, int size, unsigned int color, const char* format, ...);
+
+	/**
+	 Handle to an image loaded by loadTexture, or to a rectangular region
+	 of one made by subTexture.  Regions of the same image share an OpenGL
+	 texture, so sprites drawn from them batch into a single draw call.
+	*/
+	struct Texture
+	{
+		unsigned int id = 0;	// 0 when no image is loaded
+		int x = 0;				// left of the region in image pixels
+		int y = 0;				// top of the region in image pixels
+		int width = 0;			// region width in pixels
+		int height = 0;			// region height in pixels
+	};
+
+	/**
+	 Rectangle in pixels
+	*/
+	struct Rect
+	{
+		float x, y, width, height;
+	};
+
+	/**
+	 Sprite mirroring flags for drawSprite, may be combined with |
+	*/
+	enum Flip {
+		FlipNone = 0,
+		FlipHorizontal = 1,
+		FlipVertical = 2
+	};
+
+	/**
+	 Create a texture from 32-bit RGBA pixels in memory
+	 Parameters:
+		pixels	- width * height * 4 bytes, rows from top to bottom
+		width	- of the image in pixels
+		height	- of the image in pixels
+		smooth	- filter pixels when scaled, otherwise keep them square (default=false)
+	 Returns:
+		Texture	- handle covering the whole image, id is 0 on failure
+	*/
+	Texture loadTexture(const unsigned char* pixels, int width, int height, bool smooth = false);
+
+	/**
+	 Create a texture from an image file, see decodeImage for formats
+	 Parameters:
+		filename	- path of the image file
+		smooth		- filter pixels when scaled, otherwise keep them square (default=false)
+	 Returns:
+		Texture	- handle covering the whole image, id is 0 on failure
+	*/
+	Texture loadTexture(const std::string& filename, bool smooth = false);
+	Texture loadTexture(const char* filename, bool smooth = false);
+
+	/**
+	 Create a texture from an image in an asset pack.  The pixels are
+	 uploaded straight from the mapped pack file without decoding.
+	 Parameters:
+		pack	- pack opened by openPack
+		name	- path of the image in the pack
+		smooth	- filter pixels when scaled, otherwise keep them square (default=false)
+	 Returns:
+		Texture	- handle covering the whole image, id is 0 on failure
+	*/
+	Texture loadTexture(AssetPack pack, std::string_view name, bool smooth = false);
+
+	/**
+	 Start loading a texture from an image file.  The file is read and
+	 decoded on the loader thread and uploaded by a later windowPaint.
+	 The handle can be drawn at once: until the upload it draws as a solid
+	 quad in the tint color, and if the file cannot be loaded it draws
+	 nothing.  Its width and height stay 0 until textureReady fills them in.
+	 Parameters:
+		filename	- path of a QOI, BMP or PPM/PGM file
+		smooth		- filter pixels when scaled, otherwise keep them square (default=false)
+	 Returns:
+		Texture	- handle to the loading texture
+	*/
+	Texture loadTextureAsync(const std::string& filename, bool smooth = false);
+	Texture loadTextureAsync(const char* filename, bool smooth = false);
+
+	/**
+	 Start loading a texture from an image in an asset pack, see
+	 loadTextureAsync.  The pack may itself still be loading from
+	 openPackAsync, but must not be closed before the texture is ready.
+	 Parameters:
+		pack	- pack opened by openPack or openPackAsync
+		name	- path of the image in the pack
+		smooth	- filter pixels when scaled, otherwise keep them square (default=false)
+	 Returns:
+		Texture	- handle to the loading texture
+	*/
+	Texture loadTextureAsync(AssetPack pack, std::string_view name, bool smooth = false);
 
+	/**
+	 Start mapping an asset pack on the loader thread.  The whole file is
+	 read in before the pack opens in a later windowPaint, until then
+	 findAsset fails on the handle.
+	 Parameters:
+		filename	- path of the pack
+	 Returns:
+		AssetPack	- handle to the loading pack
+	*/
+	AssetPack openPackAsync(const std::string& filename);
+	AssetPack openPackAsync(const char* filename);
+
+	/**
+	 Check whether an async texture has been uploaded, and fill in its
+	 width and height once it has
+	 Parameters:
+		texture	- handle from loadTextureAsync
+	 Returns:
+		bool	- false while loading or if the load failed
+	*/
+	bool textureReady(Texture& texture);
+
+	/**
+	 Returns the number of async loads not finished yet
+	 Returns:
+		int	- 0 when everything started has loaded
+	*/
+	int pendingLoads();
+
+	/**
+	 Limit the work windowPaint spends finishing async loads so loading
+	 never causes a slow frame.  Loads wait for a later paint once either
+	 limit is reached, but at least one finishes per paint.
+	 Parameters:
+		bytes			- pixel data uploaded per paint (default=4 MiB)
+		milliseconds	- time spent per paint (default=2)
+	 Returns:
+		void
+	*/
+	void setUploadBudget(int bytes, double milliseconds);
+
+	/**
+	 Make a handle to part of a texture, e.g. one frame of a sprite sheet
+	 Parameters:
+		texture	- texture or region to take the part from
+		x		- left of the part, relative to the texture's region
+		y		- top of the part, relative to the texture's region
+		width	- of the part in pixels
+		height	- of the part in pixels
+	 Returns:
+		Texture	- handle sharing the image of texture
+	*/
+	Texture subTexture(const Texture& texture, int x, int y, int width, int height);
+
+	/**
+	 Release the image of a texture.  Every region of the image becomes
+	 invalid.  Textures from atlasAdd share their atlas page and are left
+	 alone, they are released together by freeAtlas.
+	 Parameters:
+		texture	- texture to release, id is set to 0
+	 Returns:
+		void
+	*/
+	void freeTexture(Texture& texture);
+
+	/**
+	 Handle to a texture atlas made by createAtlas.  An atlas packs many
+	 small images into a few large textures (pages) so sprites drawn from
+	 the same page share one draw call instead of binding a texture each.
+	*/
+	struct TextureAtlas
+	{
+		unsigned int id = 0;	// 0 when no atlas is created
+	};
+
+	/**
+	 Create an empty texture atlas.  Pages start small and double in size
+	 as images are added until they reach pageSize, then a new page is
+	 started.
+	 Parameters:
+		pageSize	- largest width and height of a page in pixels (default=2048)
+		padding		- pixels between images, filled with the image edges
+					  so smooth filtering does not bleed (default=1)
+		smooth		- filter pixels when scaled, otherwise keep them square (default=false)
+	 Returns:
+		TextureAtlas	- handle to the new atlas
+	*/
+	TextureAtlas createAtlas(int pageSize = 2048, int padding = 1, bool smooth = false);
+
+	/**
+	 Pack an image of 32-bit RGBA pixels into an atlas.  Images too large
+	 for a page are given a texture of their own.
+	 Parameters:
+		atlas	- atlas to add the image to
+		pixels	- width * height * 4 bytes, rows from top to bottom
+		width	- of the image in pixels
+		height	- of the image in pixels
+	 Returns:
+		Texture	- region of an atlas page holding the image, id is 0 on failure
+	*/
+	Texture atlasAdd(TextureAtlas atlas, const unsigned char* pixels, int width, int height);
+
+	/**
+	 Pack an image file into an atlas, see loadTexture for formats
+	 Parameters:
+		atlas		- atlas to add the image to
+		filename	- path of the image file
+	 Returns:
+		Texture	- region of an atlas page holding the image, id is 0 on failure
+	*/
+	Texture atlasAdd(TextureAtlas atlas, const std::string& filename);
+	Texture atlasAdd(TextureAtlas atlas, const char* filename);
+
+	/**
+	 Release every page of an atlas.  All textures added to it become
+	 invalid.
+	 Parameters:
+		atlas	- atlas to release, id is set to 0
+	 Returns:
+		void
+	*/
+	void freeAtlas(TextureAtlas& atlas);
+
+	/**
+	 Draw a texture, or a region of one, as a rectangle
+	 Parameters:
+		texture		- image to draw
+		x			- left side coordinate
+		y			- bottom coordinate
+		width		- in pixels
+		height		- in pixels
+		rotation	- counter-clockwise around the center, in degrees (default=0)
+		tint		- multiplied with the image colors (default=White, unchanged)
+		flip		- Flip flags to mirror the image (default=FlipNone)
+	 Returns:
+		void
+	*/
+	void drawSprite(const Texture& texture, float x, float y, float width, float height,
+		float rotation = 0, unsigned int tint = White, int flip = FlipNone);
+
+	/**
+	 Draw part of a texture as a rectangle
+	 Parameters:
+		texture		- image to draw
+		source		- part of the texture in pixels, relative to its region
+		x			- left side coordinate
+		y			- bottom coordinate
+		width		- in pixels
+		height		- in pixels
+		rotation	- counter-clockwise around the center, in degrees (default=0)
+		tint		- multiplied with the image colors (default=White, unchanged)
+		flip		- Flip flags to mirror the image (default=FlipNone)
+	 Returns:
+		void
+	*/
+	void drawSprite(const Texture& texture, const Rect& source, float x, float y, float width, float height,
+		float rotation = 0, unsigned int tint = White, int flip = FlipNone);
+
+	struct TextBlockData;
+
+	/**
+	 Text laid out once and drawn many times, for labels, menus and other
+	 text that rarely changes.  The glyph geometry is built when the text,
+	 size or color is set and kept, so drawing it copies the geometry into
+	 the frame instead of decoding every character again.
+
+	 A block that was moved from holds no text and draws nothing, its
+	 getters return the defaults of an empty block.  It can be given new
+	 text, size or color, which lays it out again.
+	*/
+	class TextBlock
+	{
+	public:
+		TextBlock();
+		explicit TextBlock(std::string_view text, int size = 1, unsigned int color = White);
+		~TextBlock();
+
+		TextBlock(const TextBlock&) = delete;
+		TextBlock& operator=(const TextBlock&) = delete;
+		TextBlock(TextBlock&& other) noexcept;
+		TextBlock& operator=(TextBlock&& other) noexcept;
+
+		/**
+		 Change the text, laid out again only if it differs
+		 Parameters:
+			text	- string of characters to draw
+		 Returns:
+			void
+		*/
+		void setText(std::string_view text);
+
+		/**
+		 Change the character size, laid out again only if it differs
+		 Parameters:
+			size	- multiplier for size of characters, i.e 2=16x16
+		 Returns:
+			void
+		*/
+		void setSize(int size);
+
+		/**
+		 Change the color, recolors the kept geometry without laying it out
+		 Parameters:
+			color	- fill color
+		 Returns:
+			void
+		*/
+		void setColor(unsigned int color);
+
+		std::string_view getText() const;
+		int getSize() const;
+		unsigned int getColor() const;
+
+		/**
+		 Returns the area the text covers, relative to the x and y it is
+		 drawn at
+		 Returns:
+			Rect	- bounding box, 0 by 0 for empty text
+		*/
+		Rect getBounds() const;
+
+	private:
+		friend class Context;
+		friend class CommandList;
+		std::unique_ptr<TextBlockData> m_data;
+	};
+
+	/**
+	 Draw text laid out by a TextBlock
+	 Parameters:
+		x		- left side of first character
+		y		- bottom of of characters
+		block	- text to draw
+	 Returns:
+		void
+	*/
+	void drawText(float x, float y, const TextBlock& block);
+
+	/**
+	 Horizontal alignment of the lines of drawTextBox
+	*/
+	enum TextAlign {
+		AlignLeft = 0,
+		AlignCenter = 1,
+		AlignRight = 2
+	};
+
+	/**
+	 Size of text laid out by measureText
+	*/
+	struct TextMetrics
+	{
+		float width;	// of the widest line
+		float height;	// of all lines
+		int lines;		// 0 for empty text
+	};
+
+	/**
+	 Measure text as drawTextBox lays it out.  Lines end at \n and, with
+	 a wrap width, before a word that would cross it; a word longer than
+	 the width is split.  Layouts are kept in a cache of recently used
+	 text, so measuring and drawing the same text again is a lookup.
+	 Parameters:
+		text		- string of characters
+		size		- multiplier for size of characters (default=1), i.e 2=16x16
+		wrapWidth	- width in pixels to wrap lines to, 0 for no wrapping (default=0)
+	 Returns:
+		TextMetrics	- width, height and number of lines
+	*/
+	TextMetrics measureText(std::string_view text, int size = 1, float wrapWidth = 0);
+
+	/**
+	 Draw text inside a box, starting at its top.  Lines end at \n and,
+	 when wrapping, at the width of the box, see measureText.  Pixels
+	 outside the box are not drawn.
+	 Parameters:
+		box		- area to draw in, x and y are its bottom left corner
+		text	- string of characters to draw
+		size	- multiplier for size of characters (default=1), i.e 2=16x16
+		color	- fill color (default=White)
+		align	- TextAlign of each line in the box (default=AlignLeft)
+		wrap	- wrap lines to the width of the box (default=true)
+	 Returns:
+		void
+	*/
+	void drawTextBox(const Rect& box, std::string_view text, int size = 1, unsigned int color = White,
+		int align = AlignLeft, bool wrap = true);
+
+	/**
+	 Font drawn from a signed distance field, made by createSdfFont.  Each
+	 texel holds the distance to the nearest glyph edge, which filters
+	 smoothly, so glyphs stay sharp at any scale and angle and each one is
+	 drawn as a single textured quad.
+	*/
+	struct SdfFont
+	{
+		Texture texture;		// distance field of every glyph
+		int glyphWidth = 0;		// in font pixels
+		int glyphHeight = 0;
+		int first = 0;			// character of the first glyph
+		int count = 0;			// 0 when no font is created
+		int columns = 0;		// glyphs across the texture
+	};
+
+	/**
+	 Create a distance field font from the built in 8x8 characters that
+	 drawText uses
+	 Returns:
+		SdfFont	- the new font, count is 0 on failure
+	*/
+	SdfFont createSdfFont();
+
+	/**
+	 Create a distance field font from a bitmap font image, a grid of
+	 glyphs left to right and top to bottom.  Pixels at least half opaque
+	 are part of a glyph.
+	 Parameters:
+		image		- bitmap font, e.g. from loadImage
+		glyphWidth	- of each glyph in pixels
+		glyphHeight	- of each glyph in pixels
+		first		- character of the top left glyph (default=32, space)
+	 Returns:
+		SdfFont	- the new font, count is 0 on failure
+	*/
+	SdfFont createSdfFont(const Image& image, int glyphWidth, int glyphHeight, int first = 32);
+
+	/**
+	 Release the texture of a distance field font
+	 Parameters:
+		font	- font to release, count is set to 0
+	 Returns:
+		void
+	*/
+	void freeSdfFont(SdfFont& font);
+
+	/**
+	 Draw text with a distance field font at any scale and rotation.
+	 Characters the font has no glyph for are left as a space.
+	 Parameters:
+		x			- left side of first character
+		y			- bottom of characters
+		text		- string of characters to draw
+		font		- font from createSdfFont
+		scale		- screen pixels per font pixel, need not be whole (default=1)
+		rotation	- counter-clockwise around x, y, in degrees (default=0)
+		color		- fill color (default=White)
+	 Returns:
+		void
+	*/
+	void drawText(float x, float y, std::string_view text, const SdfFont& font, float scale = 1,
+		float rotation = 0, unsigned int color = White);
+
+	/**
+	 Draw UTF-8 text in a bitmap font, see loadFont.  Characters the font
+	 has no glyph for draw its fallback glyph.
+	 Parameters:
+		x		- left side of first character
+		y		- bottom of characters
+		text	- UTF-8 string of characters to draw
+		font	- font to draw with
+		size	- multiplier for size of characters (default=1)
+		color	- fill color (default=White)
+	 Returns:
+		void
+	*/
+	void drawText(float x, float y, std::string_view text, const BitmapFont& font, int size = 1,
+		unsigned int color = White);
+
+	struct ContextData;
+
+	/**
+	 A window with its OpenGL context, frame batch, frame stats and cache
+	 of applied OpenGL state.  Each context draws and paints on its own;
+	 the free functions above use the one returned by defaultContext.
+
+	 Open a Context for every extra window, e.g. a debug view beside the
+	 game.  All open windows share OpenGL objects, so textures, atlases
+	 and packs are loaded once and drawn in any window.
+
+	 The member functions behave like the free functions of the same name.
+	*/
+	class Context
+	{
+	public:
+		Context();
+		~Context();
+
+		Context(const Context&) = delete;
+		Context& operator=(const Context&) = delete;
+
+		/**
+		 Open the window, closing any window already open, see openWindow
+		 Returns:
+			bool	- false if the window could not be created
+		*/
+		bool open(int width, int height, const std::string& title, const WindowOptions& options = WindowOptions());
+		bool open(int width, int height, const char* title, const WindowOptions& options = WindowOptions());
+
+		/**
+		 Destroy the window, paint discards drawing until it is opened again
+		 Returns:
+			void
+		*/
+		void close();
+
+		bool isOpen() const;
+		bool closing() const;				// see windowClosing
+		void paint();						// see windowPaint
+		bool readFrame(Image& image);		// see readFrame
+		unsigned char getKey() const;
+		GLFWwindow* window() const;			// null when closed
+
+		void setLayer(int layer);
+		int getLayer() const;
+		void setDepth(float depth);
+		float getDepth() const;
+		void setBlendMode(int mode);
+		int getBlendMode() const;
+		FrameStats getFrameStats() const;
+		FrameArena& getFrameArena();		// reset by paint
+
+		void drawQuad(float x, float y, float width, float height, unsigned int color = White);
+		void drawPoint(float x, float y, float size = 1, unsigned int color = White, bool smooth = true);
+		void drawLine(float x1, float y1, float x2, float y2, float width = 1, unsigned int color = White, bool smooth = true);
+		void drawPolyline(const Point* points, int count, float width = 1, unsigned int color = White,
+			int join = JoinMiter, int cap = CapButt, bool closed = false);
+		void drawPolygon(const Point* points, int count, unsigned int color = White);
+		void drawPolygonOutline(const Point* points, int count, float width = 1, unsigned int color = White,
+			int join = JoinMiter);
+		void drawQuad(float x, float y, float width, float height, unsigned int bottomLeft, unsigned int bottomRight,
+			unsigned int topRight, unsigned int topLeft);
+		void drawCircle(float x, float y, float radius, unsigned int color = White, int sides = 360);
+		void drawGradientCircle(float x, float y, float radius, unsigned int centerColor, unsigned int edgeColor,
+			int sides = 360);
+		void drawText(float x, float y, std::string_view text, int size = 1, unsigned int color = White);
+		void drawText(float x, float y, const TextBlock& block);
+		void drawTextBox(const Rect& box, std::string_view text, int size = 1, unsigned int color = White,
+			int align = AlignLeft, bool wrap = true);
+		void drawText(float x, float y, std::string_view text, const SdfFont& font, float scale = 1,
+			float rotation = 0, unsigned int color = White);
+		void drawText(float x, float y, std::string_view text, const BitmapFont& font, int size = 1,
+			unsigned int color = White);
+		void drawNumber(float x, float y, long long value, int size = 1, unsigned int color = White);
+		void drawFormatted(float x, float y, int size, unsigned int color, const char* format, ...);
+		void drawSprite(const Texture& texture, float x, float y, float width, float height,
+			float rotation = 0, unsigned int tint = White, int flip = FlipNone);
+		void drawSprite(const Texture& texture, const Rect& source, float x, float y, float width, float height,
+			float rotation = 0, unsigned int tint = White, int flip = FlipNone);
+
+	private:
+		friend class CommandList;
+		std::unique_ptr<ContextData> m_data;
+	};
+
+	/**
+	 Returns the context the free drawing and window functions use
+	 Returns:
+		Context&	- context opened by openWindow
+	*/
+	Context& defaultContext();
+
+	struct CommandListData;
+
+	/**
+	 Draw commands recorded for a context on any thread.  Give each thread
+	 its own list: recording touches nothing shared, so threads record in
+	 parallel without locking.  submit hands the commands to the context
+	 and its next paint draws them together with its own draws, sorted by
+	 layer and depth the same way.  Lists reuse their buffers, so once they
+	 have grown, recording a similar frame does not allocate.
+
+	 The member functions behave like the free functions of the same name.
+	 The context must outlive its lists.
+	*/
+	class CommandList
+	{
+	public:
+		explicit CommandList(Context& context = defaultContext());
+		~CommandList();
+
+		CommandList(const CommandList&) = delete;
+		CommandList& operator=(const CommandList&) = delete;
+
+		/**
+		 Hand everything recorded since the last submit to the context, to
+		 be drawn by its next paint.  Safe to call while the context paints.
+		 Returns:
+			void
+		*/
+		void submit();
+
+		/**
+		 Drop everything recorded since the last submit
+		 Returns:
+			void
+		*/
+		void clear();
+
+		void setLayer(int layer);
+		int getLayer() const;
+		void setDepth(float depth);
+		float getDepth() const;
+		void setBlendMode(int mode);
+		int getBlendMode() const;
+
+		void drawQuad(float x, float y, float width, float height, unsigned int color = White);
+		void drawPoint(float x, float y, float size = 1, unsigned int color = White, bool smooth = true);
+		void drawLine(float x1, float y1, float x2, float y2, float width = 1, unsigned int color = White, bool smooth = true);
+		void drawPolyline(const Point* points, int count, float width = 1, unsigned int color = White,
+			int join = JoinMiter, int cap = CapButt, bool closed = false);
+		void drawPolygon(const Point* points, int count, unsigned int color = White);
+		void drawPolygonOutline(const Point* points, int count, float width = 1, unsigned int color = White,
+			int join = JoinMiter);
+		void drawQuad(float x, float y, float width, float height, unsigned int bottomLeft, unsigned int bottomRight,
+			unsigned int topRight, unsigned int topLeft);
+		void drawCircle(float x, float y, float radius, unsigned int color = White, int sides = 360);
+		void drawGradientCircle(float x, float y, float radius, unsigned int centerColor, unsigned int edgeColor,
+			int sides = 360);
+		void drawText(float x, float y, std::string_view text, int size = 1, unsigned int color = White);
+		void drawText(float x, float y, const TextBlock& block);
+		void drawTextBox(const Rect& box, std::string_view text, int size = 1, unsigned int color = White,
+			int align = AlignLeft, bool wrap = true);
+		void drawText(float x, float y, std::string_view text, const SdfFont& font, float scale = 1,
+			float rotation = 0, unsigned int color = White);
+		void drawText(float x, float y, std::string_view text, const BitmapFont& font, int size = 1,
+			unsigned int color = White);
+		void drawNumber(float x, float y, long long value, int size = 1, unsigned int color = White);
+		void drawFormatted(float x, float y, int size, unsigned int color, const char* format, ...);
+		void drawSprite(const Texture& texture, float x, float y, float width, float height,
+			float rotation = 0, unsigned int tint = White, int flip = FlipNone);
+		void drawSprite(const Texture& texture, const Rect& source, float x, float y, float width, float height,
+			float rotation = 0, unsigned int tint = White, int flip = FlipNone);
+
+	private:
+		std::unique_ptr<CommandListData> m_data;
+	};
 
+	// 8x8 glyphs of the printable ASCII characters, space to ~, rows top
+	// to bottom with the high bit on the left
 	const uint8_t CHARACTERS[][8] = {
 	{0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00},
 	{0x00,0x60,0x60,0x60,0x60,0x00,0x60,0x60},
@@ -230,7 +1186,38 @@ namespace fgcugl
 	{0x00,0x60,0x30,0x18,0x0C,0x06,0x03,0x01},
 	{0x00,0x3c,0x0c,0x0c,0x0c,0x0c,0x0c,0x3c},
 	{0x00,0x00,0x10,0x10,0x28,0x44,0x00,0x00},
-	{0x00,0x00,0x00,0x00,0xff,0xff,0x00,0x00}
+	{0x00,0x00,0x00,0x00,0xff,0xff,0x00,0x00},
+	{0x00,0x30,0x30,0x18,0x00,0x00,0x00,0x00},
+	{0x00,0x00,0x00,0x78,0x0c,0x7c,0xcc,0x76},
+	{0x00,0xe0,0x60,0x60,0x7c,0x66,0x66,0xdc},
+	{0x00,0x00,0x00,0x78,0xcc,0xc0,0xcc,0x78},
+	{0x00,0x1c,0x0c,0x0c,0x7c,0xcc,0xcc,0x76},
+	{0x00,0x00,0x00,0x78,0xcc,0xfc,0xc0,0x78},
+	{0x00,0x38,0x6c,0x60,0xf0,0x60,0x60,0xf0},
+	{0x00,0x00,0x00,0x76,0xcc,0x7c,0x0c,0xf8},
+	{0x00,0xe0,0x60,0x6c,0x76,0x66,0x66,0xe6},
+	{0x00,0x30,0x00,0x70,0x30,0x30,0x30,0x78},
+	{0x00,0x0c,0x00,0x0c,0x0c,0x0c,0xcc,0x78},
+	{0x00,0xe0,0x60,0x66,0x6c,0x78,0x6c,0xe6},
+	{0x00,0x70,0x30,0x30,0x30,0x30,0x30,0x78},
+	{0x00,0x00,0x00,0xcc,0xfe,0xfe,0xd6,0xc6},
+	{0x00,0x00,0x00,0xf8,0xcc,0xcc,0xcc,0xcc},
+	{0x00,0x00,0x00,0x78,0xcc,0xcc,0xcc,0x78},
+	{0x00,0x00,0x00,0xdc,0x66,0x7c,0x60,0xf0},
+	{0x00,0x00,0x00,0x76,0xcc,0x7c,0x0c,0x1e},
+	{0x00,0x00,0x00,0xdc,0x76,0x66,0x60,0xf0},
+	{0x00,0x00,0x00,0x7c,0xc0,0x78,0x0c,0xf8},
+	{0x00,0x10,0x30,0x7c,0x30,0x30,0x34,0x18},
+	{0x00,0x00,0x00,0xcc,0xcc,0xcc,0xcc,0x76},
+	{0x00,0x00,0x00,0xcc,0xcc,0xcc,0x78,0x30},
+	{0x00,0x00,0x00,0xc6,0xd6,0xfe,0xfe,0x6c},
+	{0x00,0x00,0x00,0xc6,0x6c,0x38,0x6c,0xc6},
+	{0x00,0x00,0x00,0xcc,0xcc,0x7c,0x0c,0xf8},
+	{0x00,0x00,0x00,0xfc,0x98,0x30,0x64,0xfc},
+	{0x00,0x1c,0x30,0x30,0xe0,0x30,0x30,0x1c},
+	{0x00,0x18,0x18,0x18,0x00,0x18,0x18,0x18},
+	{0x00,0xe0,0x30,0x30,0x1c,0x30,0x30,0xe0},
+	{0x00,0x76,0xdc,0x00,0x00,0x00,0x00,0x00}
 	};
 
 } // namespace fgcugl
@@ -0,0 +1,334 @@
+// file: fgcugl_alloc.cpp
+//
+// Copyright (c) 2021 Paul Allen
+//
+// This code is licensed under MIT license (see LICENSE for details)
+//
+// Allocation tracking for fgcugl
+// --------------------------------------------------------
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "fgcugl_alloc.h"
+
+#ifdef FGCUGL_TRACK_ALLOCATIONS
+
+// the allocator underneath the counting versions
+#ifdef __GLIBC__
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* pointer, size_t size);
+extern "C" void* __libc_memalign(size_t alignment, size_t size);
+extern "C" void __libc_free(void* pointer);
+#endif
+
+namespace fgcugl
+{
+	static std::atomic<uint64_t> s_allocations{ 0 };
+	static std::atomic<uint64_t> s_bytes{ 0 };
+	static std::atomic<uint64_t> s_drawAllocations{ 0 };
+	static std::atomic<bool> s_checking{ false };
+	static std::atomic<AllocationHandler> s_handler{ nullptr };
+
+	// allocations counted when the last frame started and ended
+	static uint64_t s_frameStart = 0;
+	static uint64_t s_frameAllocations = 0;
+
+	// draw functions running on this thread, see AllocationScope
+	static thread_local int t_drawDepth = 0;
+	// set while the handler runs, so its own allocations are not reported
+	static thread_local bool t_reporting = false;
+
+	// allocation function prototypes
+	void countAllocation(size_t bytes);
+	void reportAllocation(size_t bytes);
+	void* rawAllocate(size_t bytes);
+	void* rawAllocateAligned(size_t bytes, size_t alignment);
+	void rawFree(void* pointer);
+	void rawFreeAligned(void* pointer);
+
+	//-----------------------------------------------------------------------------
+	// allocation tracking
+	//-----------------------------------------------------------------------------
+
+	AllocationStats getAllocationStats()
+	{
+		AllocationStats stats;
+
+		stats.tracking = true;
+		stats.allocations = s_allocations.load();
+		stats.bytes = s_bytes.load();
+		stats.frameAllocations = s_frameAllocations;
+		stats.drawAllocations = s_drawAllocations.load();
+		return stats;
+	}
+
+	void checkDrawAllocations(bool enable, AllocationHandler handler)
+	{
+		s_handler = handler;
+		s_checking = enable;
+	}
+
+	void endAllocationFrame()
+	{
+		uint64_t allocations = s_allocations.load();
+
+		s_frameAllocations = allocations - s_frameStart;
+		s_frameStart = allocations;
+	}
+
+	AllocationScope::AllocationScope()
+	{
+		t_drawDepth++;
+	}
+
+	AllocationScope::~AllocationScope()
+	{
+		t_drawDepth--;
+	}
+
+	//-----------------------------------------------------------------------------
+	// private functions
+	//-----------------------------------------------------------------------------
+
+	/**
+	 Count an allocation, reporting it if a checked draw function made it
+	*/
+	void countAllocation(size_t bytes)
+	{
+		s_allocations.fetch_add(1, std::memory_order_relaxed);
+		s_bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+		if (t_drawDepth > 0)
+		{
+			s_drawAllocations.fetch_add(1, std::memory_order_relaxed);
+			if (s_checking.load(std::memory_order_relaxed) && !t_reporting)
+				reportAllocation(bytes);
+		}
+	}
+
+	/**
+	 Pass a draw allocation to the handler, or print it and abort
+	*/
+	void reportAllocation(size_t bytes)
+	{
+		AllocationHandler handler = s_handler.load();
+
+		t_reporting = true;
+		if (handler)
+			handler(bytes);
+		else
+		{
+			fprintf(stderr, "fgcugl: draw function allocated %zu bytes\n", bytes);
+			abort();
+		}
+		t_reporting = false;
+	}
+
+	void* rawAllocate(size_t bytes)
+	{
+#ifdef __GLIBC__
+		return __libc_malloc(bytes ? bytes : 1);
+#else
+		return malloc(bytes ? bytes : 1);
+#endif
+	}
+
+	void* rawAllocateAligned(size_t bytes, size_t alignment)
+	{
+#if defined(__GLIBC__)
+		return __libc_memalign(alignment, bytes ? bytes : 1);
+#elif defined(_WIN32)
+		return _aligned_malloc(bytes ? bytes : 1, alignment);
+#else
+		// aligned_alloc needs a size that is a multiple of the alignment
+		return aligned_alloc(alignment, (bytes + alignment - 1) / alignment * alignment);
+#endif
+	}
+
+	void rawFree(void* pointer)
+	{
+#ifdef __GLIBC__
+		__libc_free(pointer);
+#else
+		free(pointer);
+#endif
+	}
+
+	void rawFreeAligned(void* pointer)
+	{
+#ifdef _WIN32
+		_aligned_free(pointer);
+#else
+		rawFree(pointer);
+#endif
+	}
+
+} // namespace fgcugl
+
+//-----------------------------------------------------------------------------
+// replacement allocation functions
+//-----------------------------------------------------------------------------
+
+void* operator new(size_t bytes)
+{
+	fgcugl::countAllocation(bytes);
+	void* pointer = fgcugl::rawAllocate(bytes);
+	if (!pointer)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](size_t bytes)
+{
+	return operator new(bytes);
+}
+
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept
+{
+	fgcugl::countAllocation(bytes);
+	return fgcugl::rawAllocate(bytes);
+}
+
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept
+{
+	return operator new(bytes, std::nothrow);
+}
+
+void* operator new(size_t bytes, std::align_val_t alignment)
+{
+	fgcugl::countAllocation(bytes);
+	void* pointer = fgcugl::rawAllocateAligned(bytes, (size_t)alignment);
+	if (!pointer)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](size_t bytes, std::align_val_t alignment)
+{
+	return operator new(bytes, alignment);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	fgcugl::rawFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	fgcugl::rawFree(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	fgcugl::rawFree(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+	fgcugl::rawFree(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+	fgcugl::rawFree(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+	fgcugl::rawFree(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+	fgcugl::rawFreeAligned(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+	fgcugl::rawFreeAligned(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept
+{
+	fgcugl::rawFreeAligned(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept
+{
+	fgcugl::rawFreeAligned(pointer);
+}
+
+// C allocations, glibc lets a program replace malloc as long as the
+// whole family is replaced together
+#ifdef __GLIBC__
+extern "C" void* malloc(size_t bytes)
+{
+	fgcugl::countAllocation(bytes);
+	return __libc_malloc(bytes);
+}
+
+extern "C" void* calloc(size_t count, size_t bytes)
+{
+	fgcugl::countAllocation(count * bytes);
+	return __libc_calloc(count, bytes);
+}
+
+extern "C" void* realloc(void* pointer, size_t bytes)
+{
+	fgcugl::countAllocation(bytes);
+	return __libc_realloc(pointer, bytes);
+}
+
+extern "C" void* memalign(size_t alignment, size_t bytes)
+{
+	fgcugl::countAllocation(bytes);
+	return __libc_memalign(alignment, bytes);
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t bytes)
+{
+	fgcugl::countAllocation(bytes);
+	return __libc_memalign(alignment, bytes);
+}
+
+extern "C" int posix_memalign(void** pointer, size_t alignment, size_t bytes)
+{
+	fgcugl::countAllocation(bytes);
+	*pointer = __libc_memalign(alignment, bytes);
+	return *pointer ? 0 : ENOMEM;
+}
+
+extern "C" void free(void* pointer)
+{
+	__libc_free(pointer);
+}
+#endif
+
+#else
+
+namespace fgcugl
+{
+	//-----------------------------------------------------------------------------
+	// allocation tracking, not built in
+	//-----------------------------------------------------------------------------
+
+	AllocationStats getAllocationStats()
+	{
+		return AllocationStats();
+	}
+
+	void checkDrawAllocations(bool /*enable*/, AllocationHandler /*handler*/)
+	{
+	}
+
+	void endAllocationFrame()
+	{
+	}
+
+} // namespace fgcugl
+
+#endif // FGCUGL_TRACK_ALLOCATIONS
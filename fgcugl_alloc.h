@@ -0,0 +1,93 @@
+// file: fgcugl_alloc.h
+//
+// Copyright (c) 2021 Paul Allen
+//
+// This code is licensed under MIT license (see LICENSE for details)
+//
+// Allocation tracking for fgcugl
+//
+// Built with FGCUGL_TRACK_ALLOCATIONS defined, fgcugl replaces the global
+// operator new and delete, and on glibc malloc and free, with versions
+// that count every heap allocation.  Drawing is meant to stay off the
+// heap once the frame buffers have grown: after a few warm-up frames call
+// checkDrawAllocations(true) and any allocation made inside a draw
+// function is reported, so a change that brings one back is caught the
+// first time it runs.
+//
+// Without the define nothing is replaced, the counters stay zero and the
+// checks cost nothing.  Only the fgcugl sources need the define.  Address
+// and thread sanitizers replace the allocator as well, so build one or
+// the other.
+// --------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+
+#ifndef FGCUGL_ALLOC_H
+#define FGCUGL_ALLOC_H
+
+namespace fgcugl
+{
+	/**
+	 Heap allocation counters, all zero unless tracking
+	*/
+	struct AllocationStats
+	{
+		bool tracking;				// built with FGCUGL_TRACK_ALLOCATIONS
+		uint64_t allocations;		// heap allocations since the program started
+		uint64_t bytes;				// bytes those allocations asked for
+		uint64_t frameAllocations;	// allocations between the last two calls to windowPaint
+		uint64_t drawAllocations;	// allocations made inside draw functions
+	};
+
+	/**
+	 Called with the size of an allocation made inside a draw function
+	*/
+	typedef void (*AllocationHandler)(size_t bytes);
+
+	/**
+	 Returns the allocation counters, on all threads
+	 Returns:
+		AllocationStats	- counters, zero when not tracking
+	*/
+	AllocationStats getAllocationStats();
+
+	/**
+	 Report allocations made inside draw functions
+	 Parameters:
+		enable	- true to check, false to stop
+		handler	- called for each allocation, null to print the size and
+				  abort (default=null)
+	 Returns:
+		void
+	*/
+	void checkDrawAllocations(bool enable, AllocationHandler handler = nullptr);
+
+	/**
+	 Close the allocation count of the current frame, windowPaint calls this
+	 Returns:
+		void
+	*/
+	void endAllocationFrame();
+
+	/**
+	 Marks the draw function it is declared in, allocations made while it
+	 exists on a thread count as draw allocations
+	*/
+	class AllocationScope
+	{
+	public:
+#ifdef FGCUGL_TRACK_ALLOCATIONS
+		AllocationScope();
+		~AllocationScope();
+
+		AllocationScope(const AllocationScope&) = delete;
+		AllocationScope& operator=(const AllocationScope&) = delete;
+#else
+		AllocationScope() {}
+#endif
+	};
+
+} // namespace fgcugl
+
+
+#endif // FGCUGL_ALLOC_H
@@ -0,0 +1,58 @@
+// file: fgcugl_arena.cpp
+//
+// Copyright (c) 2021 Paul Allen
+//
+// This code is licensed under MIT license (see LICENSE for details)
+//
+// Frame arena for fgcugl
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <cstdint>
+#include "fgcugl_arena.h"
+
+namespace fgcugl
+{
+	// smallest block taken from the heap
+	static const size_t MIN_ARENA_BLOCK = 64 * 1024;
+
+	void* FrameArena::allocate(size_t bytes, size_t alignment)
+	{
+		if (!m_blocks.empty())
+		{
+			Block& block = m_blocks.back();
+			uintptr_t base = (uintptr_t)block.data.get();
+			size_t offset = (size_t)(((base + m_offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+
+			if (offset <= block.size && bytes <= block.size - offset)
+			{
+				m_used += offset - m_offset + bytes;
+				m_highWater = std::max(m_highWater, m_used);
+				m_offset = offset + bytes;
+				return block.data.get() + offset;
+			}
+		}
+
+		// chain a block at least as big as the arena so far, the next
+		// reset joins them
+		size_t size = std::max(std::max(bytes + alignment, m_capacity), MIN_ARENA_BLOCK);
+		m_blocks.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+		m_capacity += size;
+		m_offset = 0;
+
+		return allocate(bytes, alignment);
+	}
+
+	void FrameArena::reset()
+	{
+		if (m_blocks.size() > 1)
+		{
+			m_blocks.clear();
+			m_blocks.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[m_capacity]), m_capacity });
+		}
+
+		m_offset = 0;
+		m_used = 0;
+	}
+
+} // namespace fgcugl
@@ -0,0 +1,91 @@
+// file: fgcugl_arena.h
+//
+// Copyright (c) 2021 Paul Allen
+//
+// This code is licensed under MIT license (see LICENSE for details)
+//
+// Frame arena for fgcugl
+//
+// An arena hands out memory by moving a pointer along a block and frees
+// everything at once when it is reset, so scratch data that only lives
+// for one frame costs no trips to the heap.  When a frame needs more
+// than the arena holds another block is chained on, and the next reset
+// joins the blocks into one, so after a few frames the arena is as big
+// as the largest frame and stops allocating.
+// --------------------------------------------------------
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#ifndef FGCUGL_ARENA_H
+#define FGCUGL_ARENA_H
+
+namespace fgcugl
+{
+	/**
+	 Linear allocator reset in bulk, see getFrameArena
+	*/
+	class FrameArena
+	{
+	public:
+		FrameArena() = default;
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		/**
+		 Take memory from the arena, valid until the next reset
+		 Parameters:
+			bytes		- size of the memory
+			alignment	- power of 2 the address is a multiple of
+						  (default=alignof(std::max_align_t))
+		 Returns:
+			void*	- uninitialized memory
+		*/
+		void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+		/**
+		 Take an array from the arena, valid until the next reset.  Reset
+		 runs no destructors so only types that need none are allowed.
+		 Parameters:
+			count	- number of elements
+		 Returns:
+			T*	- uninitialized array
+		*/
+		template <typename T>
+		T* allocate(size_t count)
+		{
+			static_assert(std::is_trivially_destructible<T>::value, "arena memory is freed without destructors");
+			return (T*)allocate(count * sizeof(T), alignof(T));
+		}
+
+		/**
+		 Free everything taken from the arena at once
+		 Returns:
+			void
+		*/
+		void reset();
+
+		size_t used() const { return m_used; }				// bytes taken since the last reset
+		size_t highWater() const { return m_highWater; }	// most bytes taken between resets
+		size_t capacity() const { return m_capacity; }		// bytes held from the heap
+
+	private:
+		struct Block
+		{
+			std::unique_ptr<unsigned char[]> data;
+			size_t size;
+		};
+
+		std::vector<Block> m_blocks;	// the last is the one being filled
+		size_t m_offset = 0;			// into the last block
+		size_t m_used = 0;
+		size_t m_highWater = 0;
+		size_t m_capacity = 0;
+	};
+
+} // namespace fgcugl
+
+
+#endif // FGCUGL_ARENA_H
@@ -0,0 +1,461 @@
+// file: fgcugl_font.cpp
+//
+// Copyright (c) 2021 Paul Allen
+//
+// This code is licensed under MIT license (see LICENSE for details)
+//
+// Bitmap font loading for fgcugl
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include "fgcugl_font.h"
+#include "fgcugl_pack.h"
+
+namespace fgcugl
+{
+	static const uint32_t PSF1_MAGIC = 0x0436;
+	static const uint32_t PSF2_MAGIC = 0x864AB572;
+	static const uint32_t MAX_CODEPOINT = 0x10FFFF;
+
+	// largest font accepted by the decoders
+	static const int MAX_GLYPH_SIZE = 256;
+	static const uint32_t MAX_GLYPHS = 0x110000;
+
+	// reading helpers, the caller checks the size
+	static uint32_t readLittleEndian32(const unsigned char* data)
+	{
+		return (uint32_t)data[3] << 24 | (uint32_t)data[2] << 16 | (uint32_t)data[1] << 8 | data[0];
+	}
+
+	static uint16_t readLittleEndian16(const unsigned char* data)
+	{
+		return (uint16_t)(data[1] << 8 | data[0]);
+	}
+
+	static bool allocateFont(BitmapFont& font, int width, int height, uint32_t glyphCount)
+	{
+		if (width <= 0 || height <= 0 || width > MAX_GLYPH_SIZE || height > MAX_GLYPH_SIZE
+			|| glyphCount > MAX_GLYPHS)
+			return false;
+
+		font = BitmapFont();
+		font.width = width;
+		font.height = height;
+		font.rowBytes = (width + 7) / 8;
+		font.glyphCount = (int)glyphCount;
+		font.bitmaps.assign((size_t)glyphCount * height * font.rowBytes, 0);
+		font.advances.assign(glyphCount, (unsigned short)width);
+		return true;
+	}
+
+	// glyph mapped to a codepoint, -1 for none
+	static int mappedGlyph(const BitmapFont& font, uint32_t codepoint)
+	{
+		size_t page = codepoint >> 8;
+
+		if (page >= font.pages.size() || font.pages[page] < 0)
+			return -1;
+		return font.glyphs[font.pages[page] + (codepoint & 0xFF)];
+	}
+
+	// the preferred glyph if there is one, otherwise U+FFFD, ? or the first
+	static void chooseFallback(BitmapFont& font, int preferred)
+	{
+		font.fallback = 0;
+
+		for (int glyph : { preferred, mappedGlyph(font, 0xFFFD), mappedGlyph(font, '?') })
+		{
+			if (glyph >= 0 && glyph < font.glyphCount)
+			{
+				font.fallback = glyph;
+				return;
+			}
+		}
+	}
+
+	bool decodeFont(const unsigned char* data, size_t size, BitmapFont& font)
+	{
+		if (!data || size < 4)
+			return false;
+
+		if (readLittleEndian16(data) == PSF1_MAGIC || readLittleEndian32(data) == PSF2_MAGIC)
+			return decodePSF(data, size, font);
+		if (size >= 9 && memcmp(data, "STARTFONT", 9) == 0)
+			return decodeBDF(data, size, font);
+
+		return false;
+	}
+
+	//-----------------------------------------------------------------------------
+	// BDF
+	//-----------------------------------------------------------------------------
+
+	// next line of a text file without its line ending, false at the end
+	static bool readLine(const unsigned char* data, size_t size, size_t& p, std::string_view& line)
+	{
+		if (p >= size)
+			return false;
+
+		const char* start = (const char*)data + p;
+		const void* newline = memchr(start, '\n', size - p);
+		size_t length = newline ? (const char*)newline - start : size - p;
+
+		p += newline ? length + 1 : length;
+		line = std::string_view(start, length);
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix(1);
+		return true;
+	}
+
+	// split the keyword off the start of a line, leaving the arguments
+	static std::string_view readKeyword(std::string_view& line)
+	{
+		size_t end = std::min(line.find(' '), line.size());
+		std::string_view keyword = line.substr(0, end);
+
+		line.remove_prefix(end);
+		return keyword;
+	}
+
+	// whitespace separated integers, false if there are fewer than count
+	static bool readNumbers(std::string_view text, int* values, int count)
+	{
+		const char* p = text.data();
+		const char* end = p + text.size();
+
+		for (int i = 0; i < count; i++)
+		{
+			while (p < end && (*p == ' ' || *p == '\t'))
+				p++;
+
+			std::from_chars_result result = std::from_chars(p, end, values[i]);
+			if (result.ec != std::errc())
+				return false;
+			p = result.ptr;
+		}
+
+		return true;
+	}
+
+	static int hexDigit(char c)
+	{
+		if (c >= '0' && c <= '9')
+			return c - '0';
+		if (c >= 'A' && c <= 'F')
+			return c - 'A' + 10;
+		if (c >= 'a' && c <= 'f')
+			return c - 'a' + 10;
+		return -1;
+	}
+
+	bool decodeBDF(const unsigned char* data, size_t size, BitmapFont& font)
+	{
+		if (!data || size < 9 || memcmp(data, "STARTFONT", 9) != 0)
+			return false;
+
+		std::string_view line;
+		size_t p = 0;
+		int box[4] = {};		// font bounding box: width, height, x and y offset
+		int defaultChar = -1;
+		bool header = true;
+
+		// properties up to the first glyph, the bounding box sizes the cells
+		while (header && readLine(data, size, p, line))
+		{
+			std::string_view keyword = readKeyword(line);
+
+			if (keyword == "FONTBOUNDINGBOX")
+			{
+				if (!readNumbers(line, box, 4))
+					return false;
+			}
+			else if (keyword == "DEFAULT_CHAR")
+				readNumbers(line, &defaultChar, 1);
+			else if (keyword == "CHARS")
+				header = false;
+		}
+
+		if (header || !allocateFont(font, box[0], box[1], 0))
+			return false;
+
+		int encoding = -1;
+		int advance = box[0];
+		int bbx[4] = {};		// glyph bounding box, relative to the origin
+		int defaultGlyph = -1;
+
+		while (readLine(data, size, p, line))
+		{
+			std::string_view keyword = readKeyword(line);
+
+			if (keyword == "STARTCHAR")
+			{
+				encoding = -1;
+				advance = box[0];
+				std::copy(box, box + 4, bbx);
+			}
+			else if (keyword == "ENCODING")
+				readNumbers(line, &encoding, 1);
+			else if (keyword == "DWIDTH")
+				readNumbers(line, &advance, 1);
+			else if (keyword == "BBX")
+			{
+				if (!readNumbers(line, bbx, 4) || bbx[0] < 0 || bbx[1] < 0)
+					return false;
+			}
+			else if (keyword == "BITMAP")
+			{
+				// glyphs without a standard encoding have no codepoint to draw
+				bool keep = encoding >= 0 && (uint32_t)encoding <= MAX_CODEPOINT;
+				int glyph = font.glyphCount;
+				size_t glyphSize = (size_t)font.height * font.rowBytes;
+
+				if (keep)
+				{
+					if ((uint32_t)glyph >= MAX_GLYPHS)
+						return false;
+					font.glyphCount++;
+					font.bitmaps.resize(font.bitmaps.size() + glyphSize, 0);
+					font.advances.push_back((unsigned short)std::max(advance, 0));
+					mapGlyph(font, (uint32_t)encoding, glyph);
+					if (encoding == defaultChar)
+						defaultGlyph = glyph;
+				}
+
+				// row 0 is the top of the glyph box, the cell's bottom row is
+				// at the y offset of the font box
+				for (int row = 0; row < bbx[1]; row++)
+				{
+					if (!readLine(data, size, p, line))
+						return false;
+					if (!keep)
+						continue;
+
+					int cellRow = box[1] - 1 - (bbx[3] + bbx[1] - 1 - row - box[3]);
+					if (cellRow < 0 || cellRow >= font.height)
+						continue;
+
+					unsigned char* out = &font.bitmaps[glyph * glyphSize + cellRow * font.rowBytes];
+					for (int column = 0; column < bbx[0] && (size_t)column / 4 < line.size(); column++)
+					{
+						int digit = hexDigit(line[column / 4]);
+						if (digit < 0)
+							return false;
+
+						int cellColumn = bbx[2] - box[2] + column;
+						if ((digit & (8 >> (column & 3))) && cellColumn >= 0 && cellColumn < font.width)
+							out[cellColumn >> 3] |= (unsigned char)(0x80 >> (cellColumn & 7));
+					}
+				}
+			}
+			else if (keyword == "ENDFONT")
+				break;
+		}
+
+		if (font.glyphCount == 0)
+			return false;
+
+		chooseFallback(font, defaultGlyph);
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	// PSF
+	//-----------------------------------------------------------------------------
+
+	bool decodePSF(const unsigned char* data, size_t size, BitmapFont& font)
+	{
+		uint32_t headerSize, glyphCount, glyphSize, width, height;
+		bool unicodeTable;
+		bool version2;
+
+		if (size >= 4 && readLittleEndian16(data) == PSF1_MAGIC)
+		{
+			// mode bit 0: 512 glyphs, bits 1 and 2: unicode table
+			headerSize = 4;
+			glyphCount = data[2] & 0x01 ? 512 : 256;
+			unicodeTable = (data[2] & 0x06) != 0;
+			glyphSize = data[3];
+			width = 8;
+			height = data[3];
+			version2 = false;
+		}
+		else if (size >= 32 && readLittleEndian32(data) == PSF2_MAGIC)
+		{
+			headerSize = readLittleEndian32(data + 8);
+			unicodeTable = (readLittleEndian32(data + 12) & 0x01) != 0;
+			glyphCount = readLittleEndian32(data + 16);
+			glyphSize = readLittleEndian32(data + 20);
+			height = readLittleEndian32(data + 24);
+			width = readLittleEndian32(data + 28);
+			version2 = true;
+		}
+		else
+			return false;
+
+		if (width == 0 || width > (uint32_t)MAX_GLYPH_SIZE || height > (uint32_t)MAX_GLYPH_SIZE
+			|| glyphSize != (width + 7) / 8 * height || headerSize > size
+			|| (uint64_t)glyphCount * glyphSize > size - headerSize)
+			return false;
+		if (glyphCount == 0 || !allocateFont(font, (int)width, (int)height, glyphCount))
+			return false;
+
+		memcpy(font.bitmaps.data(), data + headerSize, (size_t)glyphCount * glyphSize);
+		size_t p = headerSize + (size_t)glyphCount * glyphSize;
+
+		if (!unicodeTable)
+		{
+			for (uint32_t glyph = 0; glyph < glyphCount; glyph++)
+				mapGlyph(font, glyph, (int)glyph);
+		}
+		else
+		{
+			// each glyph lists its codepoints up to a terminator, then
+			// sequences of combining characters the font cannot use
+			std::string_view table((const char*)data, size);
+
+			for (uint32_t glyph = 0; glyph < glyphCount && p < size; glyph++)
+			{
+				bool sequence = false;
+
+				if (!version2)
+				{
+					for (; p + 2 <= size; p += 2)
+					{
+						uint16_t value = readLittleEndian16(data + p);
+						if (value == 0xFFFF)
+						{
+							p += 2;
+							break;
+						}
+						if (value == 0xFFFE)
+							sequence = true;
+						else if (!sequence)
+							mapGlyph(font, value, (int)glyph);
+					}
+				}
+				else
+				{
+					while (p < size)
+					{
+						if (data[p] == 0xFF)
+						{
+							p++;
+							break;
+						}
+						if (data[p] == 0xFE)
+						{
+							sequence = true;
+							p++;
+							continue;
+						}
+
+						uint32_t codepoint = nextCodepoint(table, p);
+						if (!sequence)
+							mapGlyph(font, codepoint, (int)glyph);
+					}
+				}
+			}
+		}
+
+		chooseFallback(font, -1);
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	// loading and lookup
+	//-----------------------------------------------------------------------------
+
+	bool loadFont(const std::string& filename, BitmapFont& font)
+	{
+		return loadFont(filename.c_str(), font);
+	}
+
+	bool loadFont(const char* filename, BitmapFont& font)
+	{
+		MappedFile file;
+
+		if (!file.open(filename))
+			return false;
+
+		return decodeFont(file.data(), file.size(), font);
+	}
+
+	int findGlyph(const BitmapFont& font, uint32_t codepoint)
+	{
+		int glyph = mappedGlyph(font, codepoint);
+		return glyph >= 0 ? glyph : font.fallback;
+	}
+
+	void mapGlyph(BitmapFont& font, uint32_t codepoint, int glyph)
+	{
+		if (codepoint > MAX_CODEPOINT)
+			return;
+
+		size_t page = codepoint >> 8;
+		if (page >= font.pages.size())
+			font.pages.resize(page + 1, -1);
+		if (font.pages[page] < 0)
+		{
+			font.pages[page] = (int)font.glyphs.size();
+			font.glyphs.resize(font.glyphs.size() + 256, -1);
+		}
+
+		int& entry = font.glyphs[font.pages[page] + (codepoint & 0xFF)];
+		if (entry < 0)
+			entry = glyph;
+	}
+
+	uint32_t nextCodepoint(std::string_view text, size_t& index)
+	{
+		const unsigned char* p = (const unsigned char*)text.data() + index;
+		size_t left = text.size() - index;
+		unsigned char lead = p[0];
+
+		index++;
+		if (lead < 0x80)
+			return lead;
+
+		// sequence length and the smallest codepoint it may hold, so
+		// overlong forms are rejected
+		int length;
+		uint32_t codepoint, smallest;
+		if ((lead & 0xE0) == 0xC0)
+		{
+			length = 2;
+			codepoint = lead & 0x1F;
+			smallest = 0x80;
+		}
+		else if ((lead & 0xF0) == 0xE0)
+		{
+			length = 3;
+			codepoint = lead & 0x0F;
+			smallest = 0x800;
+		}
+		else if ((lead & 0xF8) == 0xF0)
+		{
+			length = 4;
+			codepoint = lead & 0x07;
+			smallest = 0x10000;
+		}
+		else
+			return 0xFFFD;
+
+		if (left < (size_t)length)
+			return 0xFFFD;
+		for (int i = 1; i < length; i++)
+		{
+			if ((p[i] & 0xC0) != 0x80)
+				return 0xFFFD;
+			codepoint = codepoint << 6 | (p[i] & 0x3F);
+		}
+
+		if (codepoint < smallest || codepoint > MAX_CODEPOINT || (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+			return 0xFFFD;
+
+		index += length - 1;
+		return codepoint;
+	}
+
+} // namespace fgcugl
@@ -0,0 +1,118 @@
+// file: fgcugl_font.h
+//
+// Copyright (c) 2021 Paul Allen
+//
+// This code is licensed under MIT license (see LICENSE for details)
+//
+// Bitmap font loading for fgcugl
+//
+// A bitmap font keeps each glyph as rows of bits in a cell of fixed size,
+// the top row first and the high bit on the left, like the built in
+// CHARACTERS.  Codepoints are found through a two level table: the high
+// bits pick a page of 256 entries and the low bits the glyph in it, so
+// a lookup is two reads whatever the size of the font.  Codepoints the
+// font has no glyph for get its fallback glyph.
+// --------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef FGCUGL_FONT_H
+#define FGCUGL_FONT_H
+
+namespace fgcugl
+{
+	/**
+	 Decoded bitmap font, ready to pass to drawText
+	*/
+	struct BitmapFont
+	{
+		int width = 0;			// of a glyph cell in pixels
+		int height = 0;
+		int rowBytes = 0;		// bytes in each row of a glyph, (width + 7) / 8
+		int glyphCount = 0;		// 0 when no font is loaded
+		int fallback = 0;		// glyph drawn for codepoints the font lacks
+		std::vector<unsigned char> bitmaps;		// glyphCount * height * rowBytes
+		std::vector<unsigned short> advances;	// pixels from each glyph to the next
+		std::vector<int> pages;		// codepoint >> 8 to its first entry in glyphs, -1 for none
+		std::vector<int> glyphs;	// glyph of each codepoint of a page, -1 for none
+	};
+
+	/**
+	 Decode a bitmap font in memory, the format is detected from its first
+	 bytes.  Supports BDF and PSF version 1 and 2, with or without a
+	 unicode table.
+	 Parameters:
+		data	- contents of the font file, e.g. an asset from a pack
+		size	- number of bytes in data
+		font	- receives the glyphs
+	 Returns:
+		bool	- false if the format is not supported or the data is damaged
+	*/
+	bool decodeFont(const unsigned char* data, size_t size, BitmapFont& font);
+
+	/**
+	 Decode a BDF (Glyph Bitmap Distribution Format) font.  Each glyph is
+	 placed in a cell the size of the font bounding box.
+	 Parameters / Returns:
+		see decodeFont
+	*/
+	bool decodeBDF(const unsigned char* data, size_t size, BitmapFont& font);
+
+	/**
+	 Decode a PC Screen Font, the format of Linux console fonts.  Without
+	 a unicode table glyph n is codepoint n.
+	 Parameters / Returns:
+		see decodeFont
+	*/
+	bool decodePSF(const unsigned char* data, size_t size, BitmapFont& font);
+
+	/**
+	 Map a font file and decode it, see decodeFont for formats
+	 Parameters:
+		filename	- path of the font file
+		font		- receives the glyphs
+	 Returns:
+		bool	- false if the file could not be read or decoded
+	*/
+	bool loadFont(const std::string& filename, BitmapFont& font);
+	bool loadFont(const char* filename, BitmapFont& font);
+
+	/**
+	 Find the glyph of a codepoint
+	 Parameters:
+		font		- font to look in
+		codepoint	- unicode character
+	 Returns:
+		int	- index of the glyph, the fallback glyph if the font has none
+	*/
+	int findGlyph(const BitmapFont& font, uint32_t codepoint);
+
+	/**
+	 Give a codepoint a glyph, keeping any glyph it has already
+	 Parameters:
+		font		- font to change
+		codepoint	- unicode character, at most 0x10FFFF
+		glyph		- index of the glyph
+	 Returns:
+		void
+	*/
+	void mapGlyph(BitmapFont& font, uint32_t codepoint, int glyph);
+
+	/**
+	 Decode the UTF-8 character at an index of a string and step past it.
+	 A byte that does not start a valid sequence is read as U+FFFD.
+	 Parameters:
+		text	- UTF-8 string
+		index	- position of the character, moved to the next one
+	 Returns:
+		uint32_t	- the codepoint
+	*/
+	uint32_t nextCodepoint(std::string_view text, size_t& index);
+
+} // namespace fgcugl
+
+
+#endif // FGCUGL_FONT_H
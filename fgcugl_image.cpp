@@ -0,0 +1,584 @@
+// file: fgcugl_image.cpp
+//
+// Copyright (c) 2021 Paul Allen
+//
+// This code is licensed under MIT license (see LICENSE for details)
+//
+// Image decoding and pixel format conversion for fgcugl textures
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include "fgcugl_image.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FGCUGL_SSE2 1
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define FGCUGL_TARGET_SSSE3
+#else
+#include <cpuid.h>
+#define FGCUGL_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FGCUGL_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace fgcugl
+{
+	// reading helpers, the caller checks the size
+	static uint32_t readBigEndian32(const unsigned char* data)
+	{
+		return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 | (uint32_t)data[2] << 8 | data[3];
+	}
+
+	static uint32_t readLittleEndian32(const unsigned char* data)
+	{
+		return (uint32_t)data[3] << 24 | (uint32_t)data[2] << 16 | (uint32_t)data[1] << 8 | data[0];
+	}
+
+	static uint16_t readLittleEndian16(const unsigned char* data)
+	{
+		return (uint16_t)(data[1] << 8 | data[0]);
+	}
+
+	// largest image accepted by the decoders, keeps width * height * 4 in range
+	static const uint64_t MAX_IMAGE_PIXELS = 400000000;
+
+	static bool allocateImage(Image& image, int64_t width, int64_t height)
+	{
+		if (width <= 0 || height <= 0 || (uint64_t)width * (uint64_t)height > MAX_IMAGE_PIXELS)
+			return false;
+
+		image.width = (int)width;
+		image.height = (int)height;
+		image.pixels.resize((size_t)width * (size_t)height * 4);
+		return true;
+	}
+
+	bool decodeImage(const unsigned char* data, size_t size, Image& image)
+	{
+		if (!data || size < 4)
+			return false;
+
+		if (memcmp(data, "qoif", 4) == 0)
+			return decodeQOI(data, size, image);
+		if (data[0] == 'B' && data[1] == 'M')
+			return decodeBMP(data, size, image);
+		if (data[0] == 'P' && (data[1] == '6' || data[1] == '5'))
+			return decodePPM(data, size, image);
+
+		return false;
+	}
+
+	bool decodeQOI(const unsigned char* data, size_t size, Image& image)
+	{
+		const size_t HEADER_SIZE = 14;
+		const size_t END_MARKER_SIZE = 8;
+
+		if (size < HEADER_SIZE + END_MARKER_SIZE || memcmp(data, "qoif", 4) != 0)
+			return false;
+
+		unsigned char channels = data[12];
+		if (channels != 3 && channels != 4)
+			return false;
+
+		// decoded apart, so image is left as it was if the data is damaged
+		Image decoded;
+		if (!allocateImage(decoded, readBigEndian32(data + 4), readBigEndian32(data + 8)))
+			return false;
+
+		unsigned char index[64][4] = {};
+		unsigned char pixel[4] = { 0, 0, 0, 0xFF };
+		unsigned char* out = decoded.pixels.data();
+		unsigned char* outEnd = out + decoded.pixels.size();
+		size_t p = HEADER_SIZE;
+		size_t end = size - END_MARKER_SIZE;
+		int run = 0;
+
+		for (; out < outEnd; out += 4)
+		{
+			if (run > 0)
+			{
+				run--;
+			}
+			else if (p < end)
+			{
+				unsigned char op = data[p++];
+
+				if (op == 0xFE)				// QOI_OP_RGB
+				{
+					if (p + 3 > end)
+						return false;
+					memcpy(pixel, data + p, 3);
+					p += 3;
+				}
+				else if (op == 0xFF)		// QOI_OP_RGBA
+				{
+					if (p + 4 > end)
+						return false;
+					memcpy(pixel, data + p, 4);
+					p += 4;
+				}
+				else if ((op & 0xC0) == 0x00)	// QOI_OP_INDEX
+				{
+					memcpy(pixel, index[op], 4);
+				}
+				else if ((op & 0xC0) == 0x40)	// QOI_OP_DIFF
+				{
+					pixel[0] += ((op >> 4) & 0x03) - 2;
+					pixel[1] += ((op >> 2) & 0x03) - 2;
+					pixel[2] += (op & 0x03) - 2;
+				}
+				else if ((op & 0xC0) == 0x80)	// QOI_OP_LUMA
+				{
+					if (p + 1 > end)
+						return false;
+					unsigned char next = data[p++];
+					int greenDiff = (op & 0x3F) - 32;
+					pixel[0] += greenDiff - 8 + ((next >> 4) & 0x0F);
+					pixel[1] += greenDiff;
+					pixel[2] += greenDiff - 8 + (next & 0x0F);
+				}
+				else						// QOI_OP_RUN
+				{
+					run = op & 0x3F;
+				}
+
+				memcpy(index[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64], pixel, 4);
+			}
+
+			memcpy(out, pixel, 4);
+		}
+
+		image = std::move(decoded);
+		return true;
+	}
+
+	bool decodeBMP(const unsigned char* data, size_t size, Image& image)
+	{
+		const size_t FILE_HEADER_SIZE = 14;
+
+		if (size < FILE_HEADER_SIZE + 40 || data[0] != 'B' || data[1] != 'M')
+			return false;
+
+		uint32_t pixelOffset = readLittleEndian32(data + 10);
+		uint32_t headerSize = readLittleEndian32(data + 14);
+		int32_t width = (int32_t)readLittleEndian32(data + 18);
+		int32_t height = (int32_t)readLittleEndian32(data + 22);
+		uint16_t bitsPerPixel = readLittleEndian16(data + 28);
+		uint32_t compression = readLittleEndian32(data + 30);
+		uint32_t colorsUsed = readLittleEndian32(data + 46);
+
+		const uint32_t BI_RGB = 0;
+		const uint32_t BI_BITFIELDS = 3;
+
+		if (headerSize < 40 || FILE_HEADER_SIZE + headerSize > size)
+			return false;
+		if (compression != BI_RGB && !(compression == BI_BITFIELDS && bitsPerPixel == 32))
+			return false;
+		if (bitsPerPixel != 8 && bitsPerPixel != 24 && bitsPerPixel != 32)
+			return false;
+
+		// rows are stored bottom up unless the height is negative
+		bool topDown = height < 0;
+		int64_t rows = topDown ? -(int64_t)height : height;
+		if (width <= 0 || rows <= 0)
+			return false;
+
+		// check the data holds every row before allocating the pixels,
+		// and decode apart so image is left as it was if the data is damaged
+		size_t stride = ((size_t)width * bitsPerPixel + 31) / 32 * 4;
+		if (pixelOffset > size || (size - pixelOffset) / stride < (size_t)rows)
+			return false;
+
+		Image decoded;
+		if (!allocateImage(decoded, width, rows))
+			return false;
+
+		// bit field masks follow a 40 byte header or are part of a larger one
+		uint32_t masks[4] = { 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000 };
+		if (compression == BI_BITFIELDS)
+		{
+			size_t maskCount = headerSize >= 56 ? 4 : 3;
+			if (FILE_HEADER_SIZE + 40 + maskCount * 4 > size)
+				return false;
+			for (size_t i = 0; i < maskCount; i++)
+				masks[i] = readLittleEndian32(data + FILE_HEADER_SIZE + 40 + i * 4);
+			if (maskCount == 3)
+				masks[3] = 0;
+		}
+
+		// 8-bit images index a palette of BGRX entries after the header
+		const unsigned char* palette = data + FILE_HEADER_SIZE + headerSize;
+		uint32_t paletteSize = colorsUsed ? colorsUsed : 256;
+		if (bitsPerPixel == 8 && (paletteSize > 256
+			|| FILE_HEADER_SIZE + headerSize + (size_t)paletteSize * 4 > size))
+			return false;
+
+		bool standardMasks = masks[0] == 0x00FF0000 && masks[1] == 0x0000FF00 && masks[2] == 0x000000FF
+			&& (masks[3] == 0xFF000000 || masks[3] == 0);
+		bool anyAlpha = false;
+
+		for (int64_t row = 0; row < rows; row++)
+		{
+			const unsigned char* in = data + pixelOffset + (size_t)row * stride;
+			unsigned char* out = decoded.pixels.data() + (size_t)(topDown ? row : rows - 1 - row) * width * 4;
+
+			if (bitsPerPixel == 24)
+			{
+				convertBGRToRGBA(in, out, width);
+			}
+			else if (bitsPerPixel == 32 && standardMasks)
+			{
+				convertBGRAToRGBA(in, out, width);
+				for (int32_t x = 0; x < width && !anyAlpha; x++)
+					anyAlpha = out[x * 4 + 3] != 0;
+			}
+			else if (bitsPerPixel == 32)
+			{
+				// any other 8-bit channel layout
+				for (int32_t x = 0; x < width; x++)
+				{
+					uint32_t value = readLittleEndian32(in + x * 4);
+					for (int c = 0; c < 4; c++)
+					{
+						uint32_t mask = masks[c];
+						unsigned char channel = 0xFF;
+						if (mask)
+						{
+							int shift = 0;
+							while (!((mask >> shift) & 1))
+								shift++;
+							channel = (unsigned char)((value & mask) >> shift);
+						}
+						out[x * 4 + c] = channel;
+					}
+				}
+				anyAlpha = true;
+			}
+			else
+			{
+				for (int32_t x = 0; x < width; x++)
+				{
+					unsigned char entry = in[x];
+					if (entry >= paletteSize)
+						entry = 0;
+					out[x * 4] = palette[entry * 4 + 2];
+					out[x * 4 + 1] = palette[entry * 4 + 1];
+					out[x * 4 + 2] = palette[entry * 4];
+					out[x * 4 + 3] = 0xFF;
+				}
+				anyAlpha = true;
+			}
+		}
+
+		// 32-bit images written without alpha leave it at zero
+		if (bitsPerPixel == 32 && (!anyAlpha || masks[3] == 0))
+		{
+			for (size_t i = 3; i < decoded.pixels.size(); i += 4)
+				decoded.pixels[i] = 0xFF;
+		}
+
+		image = std::move(decoded);
+		return true;
+	}
+
+	bool decodePPM(const unsigned char* data, size_t size, Image& image)
+	{
+		if (size < 3 || data[0] != 'P' || (data[1] != '6' && data[1] != '5'))
+			return false;
+
+		bool color = data[1] == '6';
+		size_t p = 2;
+		uint32_t fields[3] = {};
+
+		// width height maxval, separated by whitespace, # starts a comment
+		for (uint32_t& field : fields)
+		{
+			for (;;)
+			{
+				while (p < size && isspace(data[p]))
+					p++;
+				if (p >= size || data[p] != '#')
+					break;
+				while (p < size && data[p] != '\n')
+					p++;
+			}
+
+			if (p >= size || !isdigit(data[p]))
+				return false;
+			while (p < size && isdigit(data[p]) && field < 0x10000000)
+				field = field * 10 + (data[p++] - '0');
+		}
+
+		// a single whitespace character comes before the pixels
+		p++;
+
+		uint32_t maxValue = fields[2];
+		if (maxValue == 0 || maxValue > 0xFFFF)
+			return false;
+
+		// check the data holds every sample before allocating the pixels,
+		// and decode apart so image is left as it was if the data is damaged
+		size_t channels = color ? 3 : 1;
+		size_t sampleSize = maxValue > 0xFF ? 2 : 1;
+		uint64_t samples = (uint64_t)fields[0] * fields[1];
+
+		if (p > size || (size - p) / (channels * sampleSize) < samples)
+			return false;
+
+		Image decoded;
+		if (!allocateImage(decoded, fields[0], fields[1]))
+			return false;
+
+		size_t count = (size_t)samples;
+
+		const unsigned char* in = data + p;
+		unsigned char* out = decoded.pixels.data();
+
+		if (color && maxValue == 0xFF)
+		{
+			convertRGBToRGBA(in, out, count);
+			image = std::move(decoded);
+			return true;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			for (size_t c = 0; c < 3; c++)
+			{
+				const unsigned char* sample = in + (i * channels + (color ? c : 0)) * sampleSize;
+				uint32_t value = sampleSize == 2 ? (uint32_t)(sample[0] << 8 | sample[1]) : sample[0];
+				out[i * 4 + c] = (unsigned char)((std::min(value, maxValue) * 255 + maxValue / 2) / maxValue);
+			}
+			out[i * 4 + 3] = 0xFF;
+		}
+
+		image = std::move(decoded);
+		return true;
+	}
+
+	bool loadImage(const std::string& filename, Image& image)
+	{
+		return loadImage(filename.c_str(), image);
+	}
+
+	bool loadImage(const char* filename, Image& image)
+	{
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (!file)
+			return false;
+
+		std::streamoff size = file.tellg();
+		if (size <= 0)
+			return false;
+
+		std::vector<unsigned char> data((size_t)size);
+		file.seekg(0);
+		if (!file.read((char*)data.data(), size))
+			return false;
+
+		return decodeImage(data.data(), data.size(), image);
+	}
+
+	//-----------------------------------------------------------------------------
+	// pixel conversion
+	//
+	// Each conversion has a plain loop that handles the pixels left over by
+	// the SIMD loop, or all of them when the processor has no SIMD support.
+	//-----------------------------------------------------------------------------
+
+#ifdef FGCUGL_SSE2
+	/**
+	 Returns true if the processor supports SSSE3 byte shuffles
+	*/
+	static bool hasSSSE3()
+	{
+		static const bool supported = [] {
+#ifdef _MSC_VER
+			int registers[4];
+			__cpuid(registers, 1);
+			return (registers[2] & (1 << 9)) != 0;
+#else
+			unsigned int eax, ebx, ecx, edx;
+			return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSSE3) != 0;
+#endif
+		}();
+		return supported;
+	}
+
+	/**
+	 Expand 16 pixels of 3 bytes at a time into 4 byte pixels with opaque
+	 alpha, the shuffle mask chooses RGB or BGR source order
+	 Returns:
+		size_t	- number of pixels converted
+	*/
+	FGCUGL_TARGET_SSSE3
+	static size_t expandSSSE3(const unsigned char* in, unsigned char* out, size_t count, __m128i shuffle)
+	{
+		const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+		size_t i = 0;
+
+		for (; i + 16 <= count; i += 16)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(in + i * 3));
+			__m128i b = _mm_loadu_si128((const __m128i*)(in + i * 3 + 16));
+			__m128i c = _mm_loadu_si128((const __m128i*)(in + i * 3 + 32));
+
+			// bytes 0, 12, 24 and 36 each start 4 pixels
+			__m128i p0 = _mm_shuffle_epi8(a, shuffle);
+			__m128i p1 = _mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), shuffle);
+			__m128i p2 = _mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), shuffle);
+			__m128i p3 = _mm_shuffle_epi8(_mm_srli_si128(c, 4), shuffle);
+
+			_mm_storeu_si128((__m128i*)(out + i * 4), _mm_or_si128(p0, alpha));
+			_mm_storeu_si128((__m128i*)(out + i * 4 + 16), _mm_or_si128(p1, alpha));
+			_mm_storeu_si128((__m128i*)(out + i * 4 + 32), _mm_or_si128(p2, alpha));
+			_mm_storeu_si128((__m128i*)(out + i * 4 + 48), _mm_or_si128(p3, alpha));
+		}
+
+		return i;
+	}
+#endif
+
+	void convertRGBToRGBA(const unsigned char* rgb, unsigned char* rgba, size_t count)
+	{
+		size_t i = 0;
+
+#if defined(FGCUGL_SSE2)
+		if (hasSSSE3())
+			i = expandSSSE3(rgb, rgba, count,
+				_mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1));
+#elif defined(FGCUGL_NEON)
+		for (; i + 16 <= count; i += 16)
+		{
+			uint8x16x3_t in = vld3q_u8(rgb + i * 3);
+			uint8x16x4_t out = { { in.val[0], in.val[1], in.val[2], vdupq_n_u8(0xFF) } };
+			vst4q_u8(rgba + i * 4, out);
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			rgba[i * 4] = rgb[i * 3];
+			rgba[i * 4 + 1] = rgb[i * 3 + 1];
+			rgba[i * 4 + 2] = rgb[i * 3 + 2];
+			rgba[i * 4 + 3] = 0xFF;
+		}
+	}
+
+	void convertBGRToRGBA(const unsigned char* bgr, unsigned char* rgba, size_t count)
+	{
+		size_t i = 0;
+
+#if defined(FGCUGL_SSE2)
+		if (hasSSSE3())
+			i = expandSSSE3(bgr, rgba, count,
+				_mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1));
+#elif defined(FGCUGL_NEON)
+		for (; i + 16 <= count; i += 16)
+		{
+			uint8x16x3_t in = vld3q_u8(bgr + i * 3);
+			uint8x16x4_t out = { { in.val[2], in.val[1], in.val[0], vdupq_n_u8(0xFF) } };
+			vst4q_u8(rgba + i * 4, out);
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			rgba[i * 4] = bgr[i * 3 + 2];
+			rgba[i * 4 + 1] = bgr[i * 3 + 1];
+			rgba[i * 4 + 2] = bgr[i * 3];
+			rgba[i * 4 + 3] = 0xFF;
+		}
+	}
+
+	void convertBGRAToRGBA(const unsigned char* bgra, unsigned char* rgba, size_t count)
+	{
+		size_t i = 0;
+
+#if defined(FGCUGL_SSE2)
+		// swap the bytes 0 and 2 of every 32-bit pixel with shifts and masks
+		const __m128i greenAlpha = _mm_set1_epi32((int)0xFF00FF00);
+		const __m128i blueRed = _mm_set1_epi32(0x00FF00FF);
+
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i in = _mm_loadu_si128((const __m128i*)(bgra + i * 4));
+			__m128i swap = _mm_and_si128(in, blueRed);
+			swap = _mm_or_si128(_mm_srli_epi32(swap, 16), _mm_slli_epi32(swap, 16));
+			_mm_storeu_si128((__m128i*)(rgba + i * 4), _mm_or_si128(_mm_and_si128(in, greenAlpha), swap));
+		}
+#elif defined(FGCUGL_NEON)
+		for (; i + 16 <= count; i += 16)
+		{
+			uint8x16x4_t pixels = vld4q_u8(bgra + i * 4);
+			uint8x16_t blue = pixels.val[0];
+			pixels.val[0] = pixels.val[2];
+			pixels.val[2] = blue;
+			vst4q_u8(rgba + i * 4, pixels);
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			unsigned char blue = bgra[i * 4];
+			rgba[i * 4] = bgra[i * 4 + 2];
+			rgba[i * 4 + 1] = bgra[i * 4 + 1];
+			rgba[i * 4 + 2] = blue;
+			rgba[i * 4 + 3] = bgra[i * 4 + 3];
+		}
+	}
+
+	void premultiplyAlpha(unsigned char* rgba, size_t count)
+	{
+		size_t i = 0;
+
+		// color * alpha / 255 rounded, as (t + (t >> 8)) >> 8 with t = color * alpha + 128
+
+#if defined(FGCUGL_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i half = _mm_set1_epi16(128);
+		// alpha lanes multiply by 255 so alpha is unchanged
+		const __m128i colorLanes = _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+		const __m128i alphaLanes = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i in = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+			__m128i result[2];
+
+			for (int half16 = 0; half16 < 2; half16++)
+			{
+				__m128i wide = half16 ? _mm_unpackhi_epi8(in, zero) : _mm_unpacklo_epi8(in, zero);
+				__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(wide, 0xFF), 0xFF);
+				alpha = _mm_or_si128(_mm_and_si128(alpha, colorLanes), alphaLanes);
+
+				__m128i t = _mm_add_epi16(_mm_mullo_epi16(wide, alpha), half);
+				result[half16] = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+			}
+
+			_mm_storeu_si128((__m128i*)(rgba + i * 4), _mm_packus_epi16(result[0], result[1]));
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			unsigned int alpha = rgba[i * 4 + 3];
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int t = rgba[i * 4 + c] * alpha + 128;
+				rgba[i * 4 + c] = (unsigned char)((t + (t >> 8)) >> 8);
+			}
+		}
+	}
+
+} // namespace fgcugl
@@ -0,0 +1,121 @@
+// file: fgcugl_image.h
+//
+// Copyright (c) 2021 Paul Allen
+//
+// This code is licensed under MIT license (see LICENSE for details)
+//
+// Image decoding and pixel format conversion for fgcugl textures
+// --------------------------------------------------------
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#ifndef FGCUGL_IMAGE_H
+#define FGCUGL_IMAGE_H
+
+namespace fgcugl
+{
+	/**
+	 Decoded image of 32-bit RGBA pixels, rows from top to bottom, ready
+	 to pass to loadTexture or atlasAdd
+	*/
+	struct Image
+	{
+		int width = 0;
+		int height = 0;
+		std::vector<unsigned char> pixels;	// width * height * 4 bytes
+	};
+
+	/**
+	 Decode an image in memory, the format is detected from its first bytes.
+	 Supports QOI, uncompressed BMP (8, 24 and 32 bits per pixel) and
+	 binary PPM/PGM (P6/P5).
+	 Parameters:
+		data	- contents of the image file
+		size	- number of bytes in data
+		image	- receives the decoded pixels
+	 Returns:
+		bool	- false if the format is not supported or the data is damaged
+	*/
+	bool decodeImage(const unsigned char* data, size_t size, Image& image);
+
+	/**
+	 Decode a QOI image (https://qoiformat.org)
+	 Parameters / Returns:
+		see decodeImage
+	*/
+	bool decodeQOI(const unsigned char* data, size_t size, Image& image);
+
+	/**
+	 Decode an uncompressed Windows BMP image
+	 Parameters / Returns:
+		see decodeImage
+	*/
+	bool decodeBMP(const unsigned char* data, size_t size, Image& image);
+
+	/**
+	 Decode a binary PPM (P6) or PGM (P5) image
+	 Parameters / Returns:
+		see decodeImage
+	*/
+	bool decodePPM(const unsigned char* data, size_t size, Image& image);
+
+	/**
+	 Read and decode an image file, see decodeImage for formats
+	 Parameters:
+		filename	- path of the image file
+		image		- receives the decoded pixels
+	 Returns:
+		bool	- false if the file could not be read or decoded
+	*/
+	bool loadImage(const std::string& filename, Image& image);
+	bool loadImage(const char* filename, Image& image);
+
+	/**
+	 Expand 24-bit RGB pixels to 32-bit RGBA with opaque alpha.
+	 Uses SSSE3 or NEON when the processor has it.
+	 Parameters:
+		rgb		- count * 3 bytes
+		rgba	- receives count * 4 bytes, must not overlap rgb
+		count	- number of pixels
+	 Returns:
+		void
+	*/
+	void convertRGBToRGBA(const unsigned char* rgb, unsigned char* rgba, size_t count);
+
+	/**
+	 Swizzle 24-bit BGR pixels to 32-bit RGBA with opaque alpha
+	 Parameters:
+		bgr		- count * 3 bytes
+		rgba	- receives count * 4 bytes, must not overlap bgr
+		count	- number of pixels
+	 Returns:
+		void
+	*/
+	void convertBGRToRGBA(const unsigned char* bgr, unsigned char* rgba, size_t count);
+
+	/**
+	 Swizzle 32-bit BGRA pixels to RGBA, may convert in place
+	 Parameters:
+		bgra	- count * 4 bytes
+		rgba	- receives count * 4 bytes
+		count	- number of pixels
+	 Returns:
+		void
+	*/
+	void convertBGRAToRGBA(const unsigned char* bgra, unsigned char* rgba, size_t count);
+
+	/**
+	 Multiply the color of RGBA pixels by their alpha, in place
+	 Parameters:
+		rgba	- count * 4 bytes
+		count	- number of pixels
+	 Returns:
+		void
+	*/
+	void premultiplyAlpha(unsigned char* rgba, size_t count);
+
+} // namespace fgcugl
+
+
+#endif // FGCUGL_IMAGE_H
@@ -0,0 +1,494 @@
+// file: fgcugl_jobs.cpp
+//
+// Copyright (c) 2021 Paul Allen
+//
+// This code is licensed under MIT license (see LICENSE for details)
+//
+// Work-stealing job system for fgcugl
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "fgcugl_jobs.h"
+
+namespace fgcugl
+{
+	typedef std::chrono::steady_clock JobClock;
+
+	// a piece of work in a queue, small enough to copy so queuing does not allocate
+	struct Job
+	{
+		void (*run)(void* data, int begin, int end);
+		void* data;
+		int begin;
+		int end;
+		std::atomic<int>* pending;	// counted down when the job has run
+	};
+
+	// jobs of one thread.  The owner pushes and pops at the back, thieves
+	// take from the head, so the oldest and usually largest work moves.
+	struct JobQueue
+	{
+		std::mutex mutex;
+		std::vector<Job> jobs;
+		size_t head = 0;
+	};
+
+	// counters added to while a frame runs, read by endJobFrame
+	struct WorkerCounters
+	{
+		std::atomic<unsigned int> tasks{ 0 };
+		std::atomic<unsigned int> steals{ 0 };
+		std::atomic<int64_t> busy{ 0 };		// nanoseconds
+	};
+
+	struct JobSystem
+	{
+		std::vector<std::thread> threads;
+		std::vector<std::unique_ptr<JobQueue>> queues;		// one per worker, then one for other threads
+		std::vector<std::unique_ptr<WorkerCounters>> counters;
+		std::vector<WorkerStats> stats;						// of the last frame
+		JobClock::time_point frameStart;
+
+		std::atomic<int> queued{ 0 };	// jobs in all queues
+		std::mutex sleepMutex;
+		std::condition_variable wake;
+		bool stopping = false;
+	};
+
+	static JobSystem s_jobs;
+
+	// index of the worker running on this thread, -1 on other threads
+	static thread_local int t_worker = -1;
+
+	struct TaskGraphNode
+	{
+		std::function<void()> work;
+		std::vector<int> dependents;	// tasks waiting for this one
+		int dependencies = 0;			// tasks this one waits for
+	};
+
+	struct TaskGraphData
+	{
+		std::vector<TaskGraphNode> nodes;	// kept by clear for reuse
+		int count = 0;						// nodes in use
+
+		// set up by run
+		std::unique_ptr<std::atomic<int>[]> waiting;
+		int waitingSize = 0;
+		std::atomic<int> remaining{ 0 };
+	};
+
+	// job function prototypes
+	void runWorker(int worker);
+	void pushJob(const Job& job);
+	bool takeJob(Job& job);
+	void runJob(const Job& job, bool stolen);
+	void wakeWorkers(int jobs);
+	void waitJobs(std::atomic<int>& pending);
+	void runRange(void* data, int begin, int end);
+	void runGraphTask(void* data, int task, int end);
+
+	//-----------------------------------------------------------------------------
+	// job system
+	//-----------------------------------------------------------------------------
+
+	void startJobs(int workers)
+	{
+		if (!s_jobs.threads.empty())
+			return;
+
+		if (workers <= 0)
+			workers = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+
+		for (int i = 0; i <= workers; i++)
+			s_jobs.queues.push_back(std::make_unique<JobQueue>());
+		for (int i = 0; i < workers; i++)
+			s_jobs.counters.push_back(std::make_unique<WorkerCounters>());
+		s_jobs.stats.assign(workers, WorkerStats());
+		s_jobs.frameStart = JobClock::now();
+		s_jobs.stopping = false;
+
+		for (int i = 0; i < workers; i++)
+			s_jobs.threads.emplace_back(runWorker, i);
+	}
+
+	void stopJobs()
+	{
+		if (s_jobs.threads.empty())
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(s_jobs.sleepMutex);
+			s_jobs.stopping = true;
+		}
+		s_jobs.wake.notify_all();
+
+		for (std::thread& thread : s_jobs.threads)
+			thread.join();
+
+		s_jobs.threads.clear();
+		s_jobs.queues.clear();
+		s_jobs.counters.clear();
+		s_jobs.stats.clear();
+	}
+
+	int jobWorkers()
+	{
+		return (int)s_jobs.threads.size();
+	}
+
+	void parallelFor(int count, int grain, const std::function<void(int begin, int end)>& body)
+	{
+		if (count <= 0)
+			return;
+
+		// a few pieces per thread so threads that finish early can steal
+		int threads = jobWorkers() + 1;
+		int pieces = std::min(count / std::max(grain, 1), threads * 4);
+
+		if (threads == 1 || pieces <= 1)
+		{
+			body(0, count);
+			return;
+		}
+
+		std::atomic<int> pending(pieces);
+		void* data = (void*)&body;
+
+		for (int i = 1; i < pieces; i++)
+		{
+			int begin = (int)((int64_t)count * i / pieces);
+			int end = (int)((int64_t)count * (i + 1) / pieces);
+			pushJob({ runRange, data, begin, end, &pending });
+		}
+		wakeWorkers(pieces - 1);
+
+		// the first piece runs here while the workers start on the rest
+		runJob({ runRange, data, 0, (int)((int64_t)count / pieces), &pending }, false);
+		waitJobs(pending);
+	}
+
+	WorkerStats getWorkerStats(int worker)
+	{
+		if (worker < 0 || worker >= (int)s_jobs.stats.size())
+			return WorkerStats();
+
+		return s_jobs.stats[worker];
+	}
+
+	void endJobFrame()
+	{
+		if (s_jobs.threads.empty())
+			return;
+
+		JobClock::time_point now = JobClock::now();
+		double frame = std::chrono::duration<double>(now - s_jobs.frameStart).count();
+		s_jobs.frameStart = now;
+
+		for (size_t i = 0; i < s_jobs.counters.size(); i++)
+		{
+			WorkerCounters& counters = *s_jobs.counters[i];
+			WorkerStats& stats = s_jobs.stats[i];
+
+			stats.tasks = counters.tasks.exchange(0);
+			stats.steals = counters.steals.exchange(0);
+			stats.busy = counters.busy.exchange(0) / 1e9;
+			stats.utilization = frame > 0 ? std::min(1.0, stats.busy / frame) : 0;
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// TaskGraph
+	//-----------------------------------------------------------------------------
+
+	TaskGraph::TaskGraph() : m_data(std::make_unique<TaskGraphData>())
+	{
+	}
+
+	TaskGraph::~TaskGraph() = default;
+
+	int TaskGraph::add(std::function<void()> work)
+	{
+		TaskGraphData& data = *m_data;
+
+		if (data.count == (int)data.nodes.size())
+			data.nodes.emplace_back();
+
+		TaskGraphNode& node = data.nodes[data.count];
+		node.work = std::move(work);
+		node.dependents.clear();
+		node.dependencies = 0;
+
+		return data.count++;
+	}
+
+	void TaskGraph::depend(int task, int on)
+	{
+		TaskGraphData& data = *m_data;
+
+		// waiting only for earlier tasks keeps the graph free of cycles
+		// and makes the order tasks were added in a valid order to run them
+		if (on < 0 || on >= task || task >= data.count)
+			return;
+
+		data.nodes[on].dependents.push_back(task);
+		data.nodes[task].dependencies++;
+	}
+
+	void TaskGraph::run()
+	{
+		TaskGraphData& data = *m_data;
+
+		if (data.count == 0)
+			return;
+
+		if (jobWorkers() == 0)
+		{
+			for (int i = 0; i < data.count; i++)
+				data.nodes[i].work();
+			return;
+		}
+
+		if (data.waitingSize < data.count)
+		{
+			data.waiting = std::make_unique<std::atomic<int>[]>(data.nodes.size());
+			data.waitingSize = (int)data.nodes.size();
+		}
+
+		for (int i = 0; i < data.count; i++)
+			data.waiting[i].store(data.nodes[i].dependencies, std::memory_order_relaxed);
+		data.remaining.store(data.count);
+
+		int ready = 0;
+		for (int i = 0; i < data.count; i++)
+		{
+			if (data.nodes[i].dependencies == 0)
+			{
+				pushJob({ runGraphTask, &data, i, 0, &data.remaining });
+				ready++;
+			}
+		}
+		wakeWorkers(ready);
+
+		waitJobs(data.remaining);
+	}
+
+	void TaskGraph::clear()
+	{
+		TaskGraphData& data = *m_data;
+
+		// release what the tasks captured now, the nodes are reused by add
+		for (int i = 0; i < data.count; i++)
+			data.nodes[i].work = nullptr;
+		data.count = 0;
+	}
+
+	//-----------------------------------------------------------------------------
+	// private functions
+	//-----------------------------------------------------------------------------
+
+	/**
+	 Worker thread, runs jobs until stopJobs is called and the queues are empty
+	*/
+	void runWorker(int worker)
+	{
+		t_worker = worker;
+
+		while (true)
+		{
+			Job job;
+			if (takeJob(job))
+				continue;
+
+			std::unique_lock<std::mutex> lock(s_jobs.sleepMutex);
+			s_jobs.wake.wait(lock, [] { return s_jobs.queued.load() > 0 || s_jobs.stopping; });
+			if (s_jobs.stopping && s_jobs.queued.load() == 0)
+				break;
+		}
+
+		t_worker = -1;
+	}
+
+	/**
+	 Queue a job on this thread's queue, or the shared queue when called
+	 from a thread that is not a worker.  wakeWorkers must follow.
+	*/
+	void pushJob(const Job& job)
+	{
+		JobQueue& queue = *s_jobs.queues[t_worker >= 0 ? t_worker : s_jobs.queues.size() - 1];
+
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(job);
+		s_jobs.queued++;
+	}
+
+	/**
+	 Find a job and run it: the newest of this thread's own queue, then the
+	 oldest of the shared queue, then the oldest of the other workers'
+	 queues.
+	 Returns:
+		bool	- false if every queue was empty
+	*/
+	bool takeJob(Job& job)
+	{
+		if (s_jobs.queued.load() == 0)
+			return false;
+
+		int worker = t_worker;
+		int workers = (int)s_jobs.queues.size() - 1;
+
+		if (worker >= 0)
+		{
+			JobQueue& own = *s_jobs.queues[worker];
+			std::unique_lock<std::mutex> lock(own.mutex);
+
+			if (own.jobs.size() > own.head)
+			{
+				job = own.jobs.back();
+				own.jobs.pop_back();
+				if (own.jobs.size() == own.head)
+				{
+					own.jobs.clear();
+					own.head = 0;
+				}
+				s_jobs.queued--;
+				lock.unlock();
+
+				runJob(job, false);
+				return true;
+			}
+		}
+
+		// shared queue first, then the workers after this one in turn
+		int start = worker >= 0 ? worker + 1 : 0;
+		for (int i = 0; i <= workers; i++)
+		{
+			int victim = i == 0 ? workers : (start + i - 1) % workers;
+			if (victim == worker)
+				continue;
+
+			JobQueue& queue = *s_jobs.queues[victim];
+			std::unique_lock<std::mutex> lock(queue.mutex);
+
+			if (queue.jobs.size() > queue.head)
+			{
+				job = queue.jobs[queue.head++];
+				if (queue.jobs.size() == queue.head)
+				{
+					queue.jobs.clear();
+					queue.head = 0;
+				}
+				s_jobs.queued--;
+				lock.unlock();
+
+				runJob(job, victim != workers);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 Run a job, counting it in the stats if this thread is a worker
+	 Parameters:
+		job		- job to run
+		stolen	- the job came from another worker's queue
+	*/
+	void runJob(const Job& job, bool stolen)
+	{
+		int worker = t_worker;
+
+		if (worker < 0)
+		{
+			job.run(job.data, job.begin, job.end);
+			job.pending->fetch_sub(1);
+			return;
+		}
+
+		WorkerCounters& counters = *s_jobs.counters[worker];
+		JobClock::time_point start = JobClock::now();
+
+		job.run(job.data, job.begin, job.end);
+
+		counters.busy += std::chrono::duration_cast<std::chrono::nanoseconds>(JobClock::now() - start).count();
+		counters.tasks++;
+		if (stolen)
+			counters.steals++;
+
+		job.pending->fetch_sub(1);
+	}
+
+	/**
+	 Wake sleeping workers for newly queued jobs
+	 Parameters:
+		jobs	- number of jobs queued
+	*/
+	void wakeWorkers(int jobs)
+	{
+		if (jobs <= 0)
+			return;
+
+		// taking the lock orders the wake after a worker's check of queued
+		{
+			std::lock_guard<std::mutex> lock(s_jobs.sleepMutex);
+		}
+
+		if (jobs == 1)
+			s_jobs.wake.notify_one();
+		else
+			s_jobs.wake.notify_all();
+	}
+
+	/**
+	 Run jobs until a counter reaches zero, so a waiting thread helps
+	 instead of blocking a core
+	*/
+	void waitJobs(std::atomic<int>& pending)
+	{
+		Job job;
+
+		while (pending.load() > 0)
+		{
+			if (!takeJob(job))
+				std::this_thread::yield();
+		}
+	}
+
+	/**
+	 Job function of parallelFor, data is the body
+	*/
+	void runRange(void* data, int begin, int end)
+	{
+		(*(const std::function<void(int, int)>*)data)(begin, end);
+	}
+
+	/**
+	 Job function of TaskGraph::run, runs a task then queues the tasks
+	 that were only waiting for it
+	*/
+	void runGraphTask(void* data, int task, int /*end*/)
+	{
+		TaskGraphData& graph = *(TaskGraphData*)data;
+		TaskGraphNode& node = graph.nodes[task];
+
+		node.work();
+
+		int ready = 0;
+		for (int dependent : node.dependents)
+		{
+			if (graph.waiting[dependent].fetch_sub(1) == 1)
+			{
+				pushJob({ runGraphTask, data, dependent, 0, &graph.remaining });
+				ready++;
+			}
+		}
+		wakeWorkers(ready);
+	}
+
+} // namespace fgcugl
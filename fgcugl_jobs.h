@@ -0,0 +1,150 @@
+// file: fgcugl_jobs.h
+//
+// Copyright (c) 2021 Paul Allen
+//
+// This code is licensed under MIT license (see LICENSE for details)
+//
+// Work-stealing job system for fgcugl
+//
+// Every worker thread has its own queue of tasks.  A worker takes the
+// newest task from its own queue and, when that is empty, steals the
+// oldest task from another queue, so work spreads across all cores
+// without a shared queue to fight over.  Threads that wait for work
+// (parallelFor, TaskGraph::run) run tasks too instead of sleeping.
+//
+// Until startJobs is called everything runs on the calling thread.
+// --------------------------------------------------------
+#include <functional>
+#include <memory>
+#include <vector>
+
+#ifndef FGCUGL_JOBS_H
+#define FGCUGL_JOBS_H
+
+namespace fgcugl
+{
+	/**
+	 Start the worker threads
+	 Parameters:
+		workers	- number of threads, 0 for one per core less one for
+				  the main thread (default=0)
+	 Returns:
+		void
+	*/
+	void startJobs(int workers = 0);
+
+	/**
+	 Finish the queued tasks and end the worker threads
+	 Returns:
+		void
+	*/
+	void stopJobs();
+
+	/**
+	 Returns the number of worker threads
+	 Returns:
+		int	- 0 when the job system is not started
+	*/
+	int jobWorkers();
+
+	/**
+	 Run body over the range 0..count-1 split into pieces of at least
+	 grain items, in parallel, and wait for all of them.  The calling
+	 thread runs pieces too.
+	 Parameters:
+		count	- number of items
+		grain	- smallest number of items worth a task of its own
+		body	- called with each piece as begin, end (exclusive)
+	 Returns:
+		void
+	*/
+	void parallelFor(int count, int grain, const std::function<void(int begin, int end)>& body);
+
+	struct TaskGraphData;
+
+	/**
+	 Tasks with dependencies, built and run once per frame.  A task runs
+	 as soon as every task it depends on has finished.  clear keeps the
+	 graph's storage so rebuilding it each frame does not allocate.
+	*/
+	class TaskGraph
+	{
+	public:
+		TaskGraph();
+		~TaskGraph();
+
+		TaskGraph(const TaskGraph&) = delete;
+		TaskGraph& operator=(const TaskGraph&) = delete;
+
+		/**
+		 Add a task
+		 Parameters:
+			work	- function to run
+		 Returns:
+			int	- task number for depend
+		*/
+		int add(std::function<void()> work);
+
+		/**
+		 Make a task wait for another added before it, so a graph can
+		 never wait for itself
+		 Parameters:
+			task	- task that waits
+			on		- earlier task that must finish first
+		 Returns:
+			void
+		*/
+		void depend(int task, int on);
+
+		/**
+		 Run every task and wait until all have finished.  The calling
+		 thread runs tasks too.
+		 Returns:
+			void
+		*/
+		void run();
+
+		/**
+		 Remove every task
+		 Returns:
+			void
+		*/
+		void clear();
+
+	private:
+		std::unique_ptr<TaskGraphData> m_data;
+	};
+
+	/**
+	 How busy a worker thread was during the last frame, between the last
+	 two calls to windowPaint
+	*/
+	struct WorkerStats
+	{
+		unsigned int tasks;		// tasks run
+		unsigned int steals;	// tasks taken from other queues
+		double busy;			// seconds spent running tasks
+		double utilization;		// busy time over frame time, 0..1
+	};
+
+	/**
+	 Returns the stats of a worker for the last frame
+	 Parameters:
+		worker	- 0..jobWorkers()-1
+	 Returns:
+		WorkerStats	- zero if the worker does not exist
+	*/
+	WorkerStats getWorkerStats(int worker);
+
+	/**
+	 Close the stats of the current frame and start the next, windowPaint
+	 calls this
+	 Returns:
+		void
+	*/
+	void endJobFrame();
+
+} // namespace fgcugl
+
+
+#endif // FGCUGL_JOBS_H
@@ -0,0 +1,336 @@
+// file: fgcugl_pack.cpp
+//
+// Copyright (c) 2021 Paul Allen
+//
+// This code is licensed under MIT license (see LICENSE for details)
+//
+// Memory-mapped asset packs for fgcugl
+// --------------------------------------------------------
+
+#include <cstring>
+#include <utility>
+#include <vector>
+#include "fgcugl_pack.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fgcugl
+{
+	// an open pack, AssetPack::id is the index + 1
+	struct PackSlot
+	{
+		MappedFile file;		// not open when the slot is free
+		bool reserved = false;	// handed out by reservePack, not open yet
+		bool closed = false;	// closePack was called while reserved
+		const PackEntry* entries = nullptr;
+		const char* names = nullptr;
+		uint32_t entryCount = 0;
+	};
+
+	static std::vector<PackSlot> s_packs;
+
+	//-----------------------------------------------------------------------------
+	// MappedFile
+	//-----------------------------------------------------------------------------
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			close();
+			std::swap(m_data, other.m_data);
+			std::swap(m_size, other.m_size);
+#ifdef _WIN32
+			std::swap(m_file, other.m_file);
+			std::swap(m_mapping, other.m_mapping);
+#endif
+		}
+		return *this;
+	}
+
+	bool MappedFile::open(const std::string& filename)
+	{
+		return open(filename.c_str());
+	}
+
+	bool MappedFile::open(const char* filename)
+	{
+		close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+		if (!view)
+		{
+			if (mapping)
+				CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		m_file = file;
+		m_mapping = mapping;
+		m_data = (const unsigned char*)view;
+		m_size = (size_t)size.QuadPart;
+#else
+		int file = ::open(filename, O_RDONLY);
+		if (file < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(file, &info) != 0 || info.st_size <= 0)
+		{
+			::close(file);
+			return false;
+		}
+
+		// the mapping stays valid after the descriptor is closed
+		void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		::close(file);
+		if (view == MAP_FAILED)
+			return false;
+
+		m_data = (const unsigned char*)view;
+		m_size = (size_t)info.st_size;
+#endif
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (!m_data)
+			return;
+
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+		CloseHandle(m_mapping);
+		CloseHandle(m_file);
+		m_file = m_mapping = nullptr;
+#else
+		munmap((void*)m_data, m_size);
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	//-----------------------------------------------------------------------------
+	// asset packs
+	//-----------------------------------------------------------------------------
+
+	// pack function prototypes
+	const PackSlot* findPack(AssetPack pack);
+	void readAsset(const PackSlot& pack, const PackEntry& entry, Asset& asset);
+
+	AssetPack openPack(const std::string& filename)
+	{
+		return openPack(filename.c_str());
+	}
+
+	AssetPack openPack(const char* filename)
+	{
+		MappedFile file;
+
+		if (!file.open(filename))
+			return AssetPack();
+
+		return openPack(std::move(file));
+	}
+
+	AssetPack openPack(MappedFile&& file, AssetPack pack)
+	{
+		PackSlot data;
+		data.file = std::move(file);
+
+		// a reserved handle is released whatever happens to the file
+		if (pack.id != 0)
+		{
+			if (pack.id > s_packs.size() || !s_packs[pack.id - 1].reserved)
+				return AssetPack();
+
+			bool closed = s_packs[pack.id - 1].closed;
+			s_packs[pack.id - 1] = PackSlot();
+			if (closed)
+				return AssetPack();
+		}
+
+		if (!data.file.data())
+			return AssetPack();
+
+		// check the table of contents once so lookups can trust it
+		const unsigned char* bytes = data.file.data();
+		size_t size = data.file.size();
+		PackHeader header;
+
+		if (size < sizeof(header))
+			return AssetPack();
+		memcpy(&header, bytes, sizeof(header));
+
+		if (memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 || header.version != PACK_VERSION)
+			return AssetPack();
+		if (header.entriesOffset % alignof(PackEntry) != 0 || header.entriesOffset > size
+			|| (size - header.entriesOffset) / sizeof(PackEntry) < header.entryCount
+			|| header.namesOffset > size)
+			return AssetPack();
+
+		data.entries = (const PackEntry*)(bytes + header.entriesOffset);
+		data.names = (const char*)(bytes + header.namesOffset);
+		data.entryCount = header.entryCount;
+
+		for (uint32_t i = 0; i < data.entryCount; i++)
+		{
+			const PackEntry& entry = data.entries[i];
+
+			if (entry.offset > size || entry.size > size - entry.offset
+				|| entry.nameOffset + (uint64_t)entry.nameLength > size - header.namesOffset)
+				return AssetPack();
+			if (entry.type == PackImage && entry.size / 4 / (entry.width ? entry.width : 1) < entry.height)
+				return AssetPack();
+		}
+
+		// fill the reserved slot, otherwise reuse a closed one before growing the table
+		size_t slot = pack.id != 0 ? pack.id - 1 : 0;
+		while (pack.id == 0 && slot < s_packs.size() && (s_packs[slot].file.data() || s_packs[slot].reserved))
+			slot++;
+		if (slot == s_packs.size())
+			s_packs.emplace_back();
+
+		s_packs[slot] = std::move(data);
+		pack.id = (unsigned int)slot + 1;
+		return pack;
+	}
+
+	AssetPack reservePack()
+	{
+		AssetPack pack;
+
+		size_t slot = 0;
+		while (slot < s_packs.size() && (s_packs[slot].file.data() || s_packs[slot].reserved))
+			slot++;
+		if (slot == s_packs.size())
+			s_packs.emplace_back();
+
+		s_packs[slot].reserved = true;
+		pack.id = (unsigned int)slot + 1;
+		return pack;
+	}
+
+	void closePack(AssetPack& pack)
+	{
+		// a reserved slot stays taken until its file arrives
+		if (pack.id != 0 && pack.id <= s_packs.size() && s_packs[pack.id - 1].reserved)
+			s_packs[pack.id - 1].closed = true;
+		else if (findPack(pack))
+			s_packs[pack.id - 1] = PackSlot();
+
+		pack = AssetPack();
+	}
+
+	bool findAsset(AssetPack pack, std::string_view name, Asset& asset)
+	{
+		const PackSlot* data = findPack(pack);
+		if (!data)
+			return false;
+
+		// entries are sorted by name
+		uint32_t low = 0;
+		uint32_t high = data->entryCount;
+
+		while (low < high)
+		{
+			uint32_t middle = low + (high - low) / 2;
+			const PackEntry& entry = data->entries[middle];
+			int order = std::string_view(data->names + entry.nameOffset, entry.nameLength).compare(name);
+
+			if (order == 0)
+			{
+				readAsset(*data, entry, asset);
+				return true;
+			}
+
+			if (order < 0)
+				low = middle + 1;
+			else
+				high = middle;
+		}
+
+		return false;
+	}
+
+	int assetCount(AssetPack pack)
+	{
+		const PackSlot* data = findPack(pack);
+		return data ? (int)data->entryCount : 0;
+	}
+
+	bool getAsset(AssetPack pack, int index, Asset& asset)
+	{
+		const PackSlot* data = findPack(pack);
+		if (!data || index < 0 || (uint32_t)index >= data->entryCount)
+			return false;
+
+		readAsset(*data, data->entries[index], asset);
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	// private functions
+	//-----------------------------------------------------------------------------
+
+	/**
+	 Look up an open pack
+	 Returns:
+		const PackSlot*	- null if the handle is not an open pack
+	*/
+	const PackSlot* findPack(AssetPack pack)
+	{
+		if (pack.id == 0 || pack.id > s_packs.size() || !s_packs[pack.id - 1].file.data())
+			return nullptr;
+
+		return &s_packs[pack.id - 1];
+	}
+
+	/**
+	 Fill an Asset from a table of contents entry, pointing into the mapping
+	*/
+	void readAsset(const PackSlot& pack, const PackEntry& entry, Asset& asset)
+	{
+		asset.name = std::string_view(pack.names + entry.nameOffset, entry.nameLength);
+		asset.data = pack.file.data() + entry.offset;
+		asset.size = (size_t)entry.size;
+		asset.type = (int)entry.type;
+		asset.flags = entry.flags;
+		asset.width = (int)entry.width;
+		asset.height = (int)entry.height;
+	}
+
+} // namespace fgcugl
@@ -0,0 +1,205 @@
+// file: fgcugl_pack.h
+//
+// Copyright (c) 2021 Paul Allen
+//
+// This code is licensed under MIT license (see LICENSE for details)
+//
+// Memory-mapped asset packs for fgcugl
+//
+// A pack is a single file holding many assets, made offline by the
+// fgcupack tool.  Images are stored already decoded as 32-bit RGBA so
+// they are uploaded to textures straight from the mapped file, with no
+// decoding and no copy.  Other files (fonts, data) are stored as is.
+//
+// file layout, all numbers little-endian:
+//		PackHeader
+//		PackEntry[entryCount]	sorted by name
+//		names					not null terminated
+//		payloads				each aligned to PACK_ALIGNMENT bytes
+// --------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#ifndef FGCUGL_PACK_H
+#define FGCUGL_PACK_H
+
+namespace fgcugl
+{
+	const char PACK_MAGIC[4] = { 'F', 'G', 'P', 'K' };
+	const uint32_t PACK_VERSION = 1;
+	const uint32_t PACK_ALIGNMENT = 64;
+
+	enum PackEntryType {
+		PackImage = 1,		// width * height * 4 bytes of RGBA, rows top to bottom
+		PackData = 2		// file contents as is
+	};
+
+	enum PackEntryFlags {
+		PackPremultiplied = 1	// image colors are multiplied by alpha
+	};
+
+	struct PackHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+		uint64_t entriesOffset;
+		uint64_t namesOffset;
+	};
+
+	struct PackEntry
+	{
+		uint64_t offset;		// of the payload from the start of the file
+		uint64_t size;			// of the payload in bytes
+		uint32_t nameOffset;	// from the start of the names
+		uint32_t nameLength;
+		uint32_t type;			// PackEntryType
+		uint32_t flags;			// PackEntryFlags
+		uint32_t width;			// images only
+		uint32_t height;
+	};
+
+	static_assert(sizeof(PackHeader) == 32, "pack header must match the file layout");
+	static_assert(sizeof(PackEntry) == 40, "pack entry must match the file layout");
+
+	/**
+	 Read-only memory mapping of a whole file
+	*/
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		/**
+		 Map a file, closing any file already mapped
+		 Parameters:
+			filename	- path of the file
+		 Returns:
+			bool	- false if the file could not be opened or is empty
+		*/
+		bool open(const std::string& filename);
+		bool open(const char* filename);
+
+		/**
+		 Unmap the file
+		 Returns:
+			void
+		*/
+		void close();
+
+		const unsigned char* data() const { return m_data; }
+		size_t size() const { return m_size; }
+
+	private:
+		const unsigned char* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#endif
+	};
+
+	/**
+	 Handle to an asset pack opened by openPack
+	*/
+	struct AssetPack
+	{
+		unsigned int id = 0;	// 0 when no pack is open
+	};
+
+	/**
+	 An asset inside a pack.  The data points into the mapped file and is
+	 valid until the pack is closed.
+	*/
+	struct Asset
+	{
+		std::string_view name;
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+		int type = 0;			// PackEntryType
+		unsigned int flags = 0;	// PackEntryFlags
+		int width = 0;			// images only
+		int height = 0;
+	};
+
+	/**
+	 Map an asset pack file and check its table of contents
+	 Parameters:
+		filename	- path of the pack
+	 Returns:
+		AssetPack	- handle to the pack, id is 0 on failure
+	*/
+	AssetPack openPack(const std::string& filename);
+	AssetPack openPack(const char* filename);
+
+	/**
+	 Check the table of contents of a file already mapped and take it over,
+	 used to finish packs mapped on another thread
+	 Parameters:
+		file	- mapping of the pack file, closed on failure
+		pack	- handle from reservePack to fill, or id 0 for a new handle
+	 Returns:
+		AssetPack	- handle to the pack, id is 0 on failure or if the
+					  reserved handle was closed meanwhile
+	*/
+	AssetPack openPack(MappedFile&& file, AssetPack pack = AssetPack());
+
+	/**
+	 Reserve a handle for a pack that is still loading.  findAsset fails
+	 and assetCount is 0 until openPack fills it.
+	 Returns:
+		AssetPack	- reserved handle
+	*/
+	AssetPack reservePack();
+
+	/**
+	 Unmap an asset pack.  Textures already loaded from it stay valid.
+	 Parameters:
+		pack	- pack to close, id is set to 0
+	 Returns:
+		void
+	*/
+	void closePack(AssetPack& pack);
+
+	/**
+	 Find an asset by name, a binary search of the table of contents
+	 Parameters:
+		pack	- pack to search
+		name	- path of the asset relative to the packed directory, using /
+		asset	- receives the asset
+	 Returns:
+		bool	- false if there is no asset with the name
+	*/
+	bool findAsset(AssetPack pack, std::string_view name, Asset& asset);
+
+	/**
+	 Returns the number of assets in a pack
+	 Returns:
+		int	- asset count, 0 if the pack is not open
+	*/
+	int assetCount(AssetPack pack);
+
+	/**
+	 Get an asset by its position in the pack, assets are sorted by name
+	 Parameters:
+		pack	- pack to read
+		index	- 0 to assetCount - 1
+		asset	- receives the asset
+	 Returns:
+		bool	- false if the index is out of range
+	*/
+	bool getAsset(AssetPack pack, int index, Asset& asset);
+
+} // namespace fgcugl
+
+
+#endif // FGCUGL_PACK_H
@@ -0,0 +1,181 @@
+// file: fgcupack.cpp
+//
+// Copyright (c) 2021 Paul Allen
+//
+// This code is licensed under MIT license (see LICENSE for details)
+//
+// Offline packer for fgcugl asset packs, see fgcugl_pack.h
+//
+// Every file under the input directory becomes an asset named by its
+// path relative to the directory.  Images fgcugl can decode are stored
+// as RGBA pixels, everything else is stored as is.
+//
+//		usage: fgcupack [-p] <directory> <pack file>
+//			-p	premultiply image colors by alpha
+//
+//		build: g++ -std=c++17 -O2 tools/fgcupack.cpp fgcugl_image.cpp -o fgcupack
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../fgcugl_image.h"
+#include "../fgcugl_pack.h"
+
+namespace fs = std::filesystem;
+using namespace fgcugl;
+
+// an asset waiting to be written
+struct PackInput
+{
+	std::string name;
+	PackEntry entry;
+	std::vector<unsigned char> payload;
+};
+
+/**
+ Read a whole file
+ Returns:
+	bool	- false if the file could not be read
+*/
+static bool readFile(const fs::path& path, std::vector<unsigned char>& data)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+
+	data.resize((size_t)file.tellg());
+	file.seekg(0);
+	return (bool)file.read((char*)data.data(), data.size());
+}
+
+/**
+ Round up to the next multiple of PACK_ALIGNMENT
+*/
+static uint64_t align(uint64_t offset)
+{
+	return (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+}
+
+int main(int argc, char* argv[])
+{
+	bool premultiply = false;
+	int arg = 1;
+
+	if (arg < argc && strcmp(argv[arg], "-p") == 0)
+	{
+		premultiply = true;
+		arg++;
+	}
+
+	if (argc - arg != 2)
+	{
+		fprintf(stderr, "usage: fgcupack [-p] <directory> <pack file>\n");
+		return 1;
+	}
+
+	fs::path directory = argv[arg];
+	fs::path output = argv[arg + 1];
+	std::vector<PackInput> inputs;
+	std::error_code error;
+
+	for (const fs::directory_entry& file : fs::recursive_directory_iterator(directory, error))
+	{
+		if (!file.is_regular_file())
+			continue;
+
+		PackInput input;
+		input.name = file.path().lexically_relative(directory).generic_string();
+		input.entry = {};
+
+		std::vector<unsigned char> data;
+		if (!readFile(file.path(), data))
+		{
+			fprintf(stderr, "fgcupack: cannot read %s\n", file.path().string().c_str());
+			return 1;
+		}
+
+		Image image;
+		if (decodeImage(data.data(), data.size(), image))
+		{
+			if (premultiply)
+			{
+				premultiplyAlpha(image.pixels.data(), image.pixels.size() / 4);
+				input.entry.flags = PackPremultiplied;
+			}
+
+			input.entry.type = PackImage;
+			input.entry.width = (uint32_t)image.width;
+			input.entry.height = (uint32_t)image.height;
+			input.payload.swap(image.pixels);
+		}
+		else
+		{
+			input.entry.type = PackData;
+			input.payload.swap(data);
+		}
+
+		inputs.push_back(std::move(input));
+	}
+
+	if (error)
+	{
+		fprintf(stderr, "fgcupack: cannot read directory %s\n", directory.string().c_str());
+		return 1;
+	}
+
+	// openPack finds assets with a binary search by name
+	std::sort(inputs.begin(), inputs.end(),
+		[](const PackInput& a, const PackInput& b) { return a.name < b.name; });
+
+	PackHeader header = {};
+	memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+	header.version = PACK_VERSION;
+	header.entryCount = (uint32_t)inputs.size();
+	header.entriesOffset = sizeof(PackHeader);
+	header.namesOffset = header.entriesOffset + inputs.size() * sizeof(PackEntry);
+
+	std::string names;
+	for (PackInput& input : inputs)
+	{
+		input.entry.nameOffset = (uint32_t)names.size();
+		input.entry.nameLength = (uint32_t)input.name.size();
+		names += input.name;
+	}
+
+	uint64_t offset = header.namesOffset + names.size();
+	for (PackInput& input : inputs)
+	{
+		offset = align(offset);
+		input.entry.offset = offset;
+		input.entry.size = input.payload.size();
+		offset += input.payload.size();
+	}
+
+	std::ofstream file(output, std::ios::binary | std::ios::trunc);
+	file.write((const char*)&header, sizeof(header));
+	for (const PackInput& input : inputs)
+		file.write((const char*)&input.entry, sizeof(PackEntry));
+	file.write(names.data(), names.size());
+
+	const char padding[PACK_ALIGNMENT] = {};
+	for (const PackInput& input : inputs)
+	{
+		file.write(padding, input.entry.offset - (uint64_t)file.tellp());
+		file.write((const char*)input.payload.data(), input.payload.size());
+	}
+
+	if (!file)
+	{
+		fprintf(stderr, "fgcupack: cannot write %s\n", output.string().c_str());
+		return 1;
+	}
+
+	printf("fgcupack: %zu assets, %llu bytes\n", inputs.size(), (unsigned long long)offset);
+	return 0;
+}